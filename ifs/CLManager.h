@@ -7,6 +7,7 @@
 #include <string>
 #include <initializer_list>
 #include <vector>
+#include <functional>
 
 #define CL_HPP_ENABLE_EXCEPTIONS
 #define CL_HPP_TARGET_OPENCL_VERSION 120
@@ -62,15 +63,19 @@ namespace CLManager
     const std::string getErrorString(int error);
 
     bool createDevice();
+    bool deviceSupportsExtension(const std::string& extension);
+    bool buildProgram(const std::string& kernelSource, cl::Program& builtProgram);
     bool loadSources(const std::string& kernelSource);
     bool init(const std::string kernelSource);
 
     void createKernel(const std::string& kernelName, uint32_t range=0);
+    void setKernelProgram(const std::string& kernelName, const cl::Program& kernelProgram);
     void setKernelRange(const std::string& kernelName, uint32_t range);
     void setKernelParamBuffer(const std::string& kernelName, uint32_t argStartNum, std::initializer_list<std::string> bufferNames);
     void setKernelParamLocal(const std::string& kernelName, uint32_t argStartNum, uint32_t numBytes);
     template<class T> void setKernelParamValue(const std::string& kernelName, uint32_t argStartNum, const T& value);
     void runKernel(const std::string& kernelName);
+    float runKernelTimed(const std::string& kernelName);
     
     template<class T> bool createBuffer(const std::string& bufferName, const uint32_t numElements, const T* data = nullptr);
     template<class T> void readBuffer(const std::string& bufferName, const uint32_t numElements, const T* dest, const uint32_t offset=0);
@@ -97,6 +102,9 @@ namespace CLManager
 
     std::unordered_map<std::string, cl::Kernel> kernels;
     std::unordered_map<std::string, cl::NDRange> kernelRanges;
+
+    //the last value set for each argument, so the arguments can be set again when a kernel is recreated from another program
+    std::unordered_map<std::string, std::unordered_map<uint32_t, std::function<int(cl::Kernel&)>>> kernelArgs;
 #if CL_MANAGER_ENABLE_TIMING
     std::unordered_map<std::string, std::vector<KernelTimeData>> kernelTimings;
     std::vector<std::string> kernelPrintOrder;
@@ -230,18 +238,26 @@ namespace CLManager
         return true;
     }
 
-    bool loadSources(const std::string& kernelSource)
+    bool deviceSupportsExtension(const std::string& extension)
     {
+        //extensions are given as one space separated string
+        std::string extensions = " " + device.getInfo<CL_DEVICE_EXTENSIONS>() + " ";
+        return extensions.find(" " + extension + " ") != std::string::npos;
+    }
+
+    bool buildProgram(const std::string& kernelSource, cl::Program& builtProgram)
+    {
+        //only uses the context and device, so can be called from another thread to compile in the background
         cl::Program::Sources sources;
         sources.push_back({ kernelSource.c_str(), kernelSource.length() });
-        program = cl::Program(context, sources);
+        builtProgram = cl::Program(context, sources);
 
         std::vector<cl::Device> d{ device };
 
-        int error = program.build(d, "-cl-finite-math-only -cl-no-signed-zeros -cl-mad-enable -w");
+        int error = builtProgram.build(d, "-cl-finite-math-only -cl-no-signed-zeros -cl-mad-enable -w");
         if (error != CL_SUCCESS)
         {
-            std::cout << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
+            std::cout << builtProgram.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
             std::cout << "failed to compile kernel code: " << getErrorString(error) << std::endl;
             return false;
         }
@@ -249,6 +265,11 @@ namespace CLManager
         return true;
     }
 
+    bool loadSources(const std::string& kernelSource)
+    {
+        return buildProgram(kernelSource, program);
+    }
+
     bool init(const std::string kernelSource)
     {
         if (!createDevice()) return false;
@@ -268,6 +289,30 @@ namespace CLManager
 #endif
     }
 
+    void setKernelProgram(const std::string& kernelName, const cl::Program& kernelProgram)
+    {
+        //replace the kernel with the one of the same name from another program, keeping all of its arguments
+        int error;
+        cl::Kernel kernel = cl::Kernel(kernelProgram, kernelName.c_str(), &error);
+        if (error != CL_SUCCESS)
+        {
+            std::cout << "error creating kernel " << kernelName << " from program: " << getErrorString(error) << std::endl;
+            return;
+        }
+
+        for (auto& arg : kernelArgs[kernelName])
+        {
+            error = arg.second(kernel);
+            if (error != CL_SUCCESS)
+            {
+                std::cout << "error code " << getErrorString(error) << " restoring parameter at position " << arg.first
+                    << " in kernel " << kernelName << std::endl;
+            }
+        }
+
+        kernels[kernelName] = kernel;
+    }
+
     void setKernelRange(const std::string& kernelName, uint32_t range)
     {
         kernelRanges[kernelName] = cl::NDRange(((range + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE) * WORKGROUP_SIZE);
@@ -277,7 +322,15 @@ namespace CLManager
     {
         for (const std::string& bufferName : bufferNames)
         {
-            int error = kernels[kernelName].setArg(argStartNum, buffers[bufferName]);
+            //looked up by name whenever the argument is applied, so the stored argument doesn't keep a deleted buffer alive.
+            //a deleted buffer is skipped, and is set again when a buffer of that name is given
+            kernelArgs[kernelName][argStartNum] = [bufferName, argStartNum](cl::Kernel& k)
+            {
+                auto it = buffers.find(bufferName);
+                return it == buffers.end() ? CL_SUCCESS : k.setArg(argStartNum, it->second);
+            };
+
+            int error = kernelArgs[kernelName][argStartNum](kernels[kernelName]);
             if (error != CL_SUCCESS)
             {
                 std::cout << "error code " << getErrorString(error) << " setting kernel buffer parameter " <<
@@ -290,7 +343,9 @@ namespace CLManager
 
     void setKernelParamLocal(const std::string& kernelName, uint32_t argStartNum, uint32_t numBytes)
     {
-        int error = kernels[kernelName].setArg(argStartNum, numBytes, NULL);
+        kernelArgs[kernelName][argStartNum] = [numBytes, argStartNum](cl::Kernel& k) { return k.setArg(argStartNum, numBytes, NULL); };
+
+        int error = kernelArgs[kernelName][argStartNum](kernels[kernelName]);
         if (error != CL_SUCCESS)
         {
             std::cout << "error code " << getErrorString(error) << " setting kernel local parameter at position " <<
@@ -301,7 +356,9 @@ namespace CLManager
     template<class T>
     void setKernelParamValue(const std::string& kernelName, uint32_t argStartNum, const T& value)
     {
-        int error = kernels[kernelName].setArg(argStartNum, sizeof(T), (void*)&value);
+        kernelArgs[kernelName][argStartNum] = [value, argStartNum](cl::Kernel& k) { return k.setArg(argStartNum, sizeof(T), (void*)&value); };
+
+        int error = kernelArgs[kernelName][argStartNum](kernels[kernelName]);
         if (error != CL_SUCCESS)
         {
             std::cout << "error code " << getErrorString(error) << " setting kernel value parameter at position "
@@ -339,6 +396,32 @@ namespace CLManager
 #endif
     }
 
+    float runKernelTimed(const std::string& kernelName)
+    {
+        //run the kernel and return how long it took on the device in milliseconds, for benchmarks
+        cl::Event event;
+        int error = queue.enqueueNDRangeKernel(kernels[kernelName], cl::NullRange, kernelRanges[kernelName], rangeLocal, nullptr, &event);
+        if (error != CL_SUCCESS)
+        {
+            std::cout << "error enqueueing kernel " << kernelName << ": " << getErrorString(error) << std::endl;
+            return 0.0f;
+        }
+
+        error = queue.finish();
+        if (error != CL_SUCCESS)
+        {
+            std::cout << "error finishing queue running kernel " << kernelName << ": " << getErrorString(error) << std::endl;
+            return 0.0f;
+        }
+
+        cl_ulong time_start;
+        cl_ulong time_end;
+        event.getProfilingInfo(CL_PROFILING_COMMAND_START, &time_start);
+        event.getProfilingInfo(CL_PROFILING_COMMAND_END, &time_end);
+
+        return (time_end - time_start) / 1e6f;
+    }
+
     template<class T>
     bool createBuffer(const std::string& bufferName, const uint32_t numElements, const T* data)
     {
@@ -618,7 +701,14 @@ namespace CLManager
     {
         for (const std::string& bufferName : bufferNames)
         {
-            int error = kernels[kernelName].setArg(argStartNum, glBuffers[bufferName].clBuffer);
+            //looked up by name like setKernelParamBuffer, so replacing the GL buffer frees the old one
+            kernelArgs[kernelName][argStartNum] = [bufferName, argStartNum](cl::Kernel& k)
+            {
+                auto it = glBuffers.find(bufferName);
+                return it == glBuffers.end() ? CL_SUCCESS : k.setArg(argStartNum, it->second.clBuffer);
+            };
+
+            int error = kernelArgs[kernelName][argStartNum](kernels[kernelName]);
             if (error != CL_SUCCESS)
             {
                 std::cout << "error code " << getErrorString(error) << " setting kernel GL buffer parameter " <<
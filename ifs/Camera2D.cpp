@@ -4,9 +4,21 @@
 #include "glm/gtc/matrix_transform.hpp"
 
 
+mat4wrap toCL(const glm::mat4& m)
+{
+	//row major copy for kernel float16 arguments
+	return {
+		m[0][0], m[1][0], m[2][0], m[3][0],
+		m[0][1], m[1][1], m[2][1], m[3][1],
+		m[0][2], m[1][2], m[2][2], m[3][2],
+		m[0][3], m[1][3], m[2][3], m[3][3]
+	};
+}
+
 void Camera2D::updateViewMatrix()
 {
-	matView = glm::ortho(position.x - view.x, position.x + view.x, position.y - view.y, position.y + view.y);
+	glm::vec2 p = glm::vec2(position);
+	matView = glm::ortho(p.x - view.x, p.x + view.x, p.y - view.y, p.y + view.y);
 }
 
 void Camera2D::setAspectRatio(const float width, const float height)
@@ -17,31 +29,41 @@ void Camera2D::setAspectRatio(const float width, const float height)
 
 mat4wrap Camera2D::getMatViewCL()
 {
-	return {
-		matView[0][0], matView[1][0], matView[2][0], matView[3][0],
-		matView[0][1], matView[1][1], matView[2][1], matView[3][1],
-		matView[0][2], matView[1][2], matView[2][2], matView[3][2],
-		matView[0][3], matView[1][3], matView[2][3], matView[3][3]
-	};
+	return toCL(matView);
+}
+
+mat4wrap Camera2D::getMatViewRelativeCL(const glm::dvec2& origin)
+{
+	//view matrix for points which have already had origin subtracted, which is done more precisely than the matrix could
+	glm::vec2 p = glm::vec2(position - origin);
+	return toCL(glm::ortho(p.x - view.x, p.x + view.x, p.y - view.y, p.y + view.y));
+}
+
+vec4wrap Camera2D::getPositionCL()
+{
+	//position as a double-float, high parts in xy and the remainders in zw
+	glm::vec2 high = glm::vec2(position);
+	glm::vec2 low = glm::vec2(position - glm::dvec2(high));
+	return { high.x, high.y, low.x, low.y };
 }
 
 void Camera2D::init(const float width, const float height, const glm::vec2& defaultPos)
 {
-	position = defaultPos;
+	position = glm::dvec2(defaultPos);
 	zoom = 0.5f;
 	setAspectRatio(width, height);
 }
 
 void Camera2D::reset()
 {
-	position = glm::vec2(0.0f);
+	position = glm::dvec2(0.0);
 	zoom = 0.5f;
 	updateViewMatrix();
 }
 
 void Camera2D::updatePosition(const glm::vec2& deltaPos)
 {
-	position += deltaPos;
+	position += glm::dvec2(deltaPos);
 	updateViewMatrix();
 }
 
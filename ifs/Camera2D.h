@@ -9,18 +9,28 @@ struct mat4wrap
 	float s[16];
 };
 
+struct vec4wrap
+{
+	float s[4];
+};
+
+mat4wrap toCL(const glm::mat4& m);
+
 class Camera2D
 {
 	void updateViewMatrix();
 
 public:
-	glm::vec2 position, view;
+	glm::dvec2 position; //double so the camera can be placed precisely at deep zooms
+	glm::vec2 view;
 	glm::mat4 matView;
 	float ar;
 	float zoom;
 
 	void setAspectRatio(const float width, const float height);
 	mat4wrap getMatViewCL();
+	mat4wrap getMatViewRelativeCL(const glm::dvec2& origin);
+	vec4wrap getPositionCL();
 
 	void init(const float width, const float height, const glm::vec2& defaultPos);
 	void reset();
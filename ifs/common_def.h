@@ -5,4 +5,104 @@
 #define MAX_VARIATIONS 16
 #define PI 3.14159265f
 
+//histogram storage formats
+#define ACCUMULATION_FLOAT 0
+#define ACCUMULATION_FIXED32 1
+#define ACCUMULATION_FIXED64 2
+
+//one channel per entry, weighted over each point's last ENTRY_HISTORY_LENGTH choices
+#define ACCUMULATION_ENTRY_CHANNELS 3
+#define ENTRY_HISTORY_BITS 4
+#define ENTRY_HISTORY_LENGTH 8
+#define ENTRY_CHANNEL_SCALE (1u << ENTRY_HISTORY_LENGTH)
+#define MAX_ENTRY_CHANNEL_MB 1024
+
+//2 uints per pixel: RGB9E5 colour sum or fixed32 palette coordinate sum, then the count
+#define ACCUMULATION_PACKED_RGB 4
+#define ACCUMULATION_PALETTE 5
+#define PACKED_MANTISSA_BITS 9
+#define PACKED_EXPONENT_BIAS 6
+
+//colour multipliers for the fixed point modes
+#define FIXED_POINT_SCALE_32 256.0f
+#define FIXED_POINT_SCALE_64 16777216.0f
+
+//hits a 32 bit pixel counts exactly, and the plots per launch of deep accumulation
+#define EXACT_32_BIT_HITS (1 << 24)
+#define DEEP_CHUNK_PLOTS (1 << 23)
+
+//fixed32, palette and per-entry pixels stop taking samples here, before their uint sums could wrap
+#define FIXED32_SATURATION_HITS (EXACT_32_BIT_HITS - (1 << 22))
+#define ENTRY_CHANNEL_SATURATION ((uint)FIXED32_SATURATION_HITS * ENTRY_CHANNEL_SCALE)
+
+//how many times the mean hits per pixel a render's busiest pixel is assumed to get
+#define PEAK_HITS_FACTOR 4096
+
+#define BINNING_DIRECT 0
+#define BINNING_LOCAL_CACHE 1
+#define BINNING_DEFERRED 2 //render only
+#define DEFERRED_BUCKET_BITS 9
+#define DEFERRED_BUCKET_PIXELS (1 << DEFERRED_BUCKET_BITS)
+#define DEFERRED_EMPTY_RECORD 0xFFFFFFFFu
+
+//tiled stores each 8x8 block of pixels together
+#define LAYOUT_LINEAR 0
+#define LAYOUT_TILED 1
+#define HISTOGRAM_TILE_BITS 3
+#define HISTOGRAM_TILE_SIZE (1 << HISTOGRAM_TILE_BITS)
+
+//pixels in each work group's local cache, and slots probed per pixel
+#define LOCAL_CACHE_BITS 8
+#define LOCAL_CACHE_SIZE (1 << LOCAL_CACHE_BITS)
+#define LOCAL_CACHE_PROBES 2
+
+//pixels either side covered by a render's tent filter
+#define MAX_SPLAT_WIDTH 2.0f
+
+#define SELECTION_LINEAR 0
+#define SELECTION_ALIAS 1
+
+#define EXECUTION_DIRECT 0
+#define EXECUTION_REGROUPED 1
+
+#define CHOICE_INDEPENDENT 0
+#define CHOICE_SHARED 1
+
+//points iterated side by side by each work item of produceSamples (1, 2, 4 or 8)
+#define CHAINS_PER_ITEM 2
+
+//where the camera position is taken off plotted points
+#define CAMERA_SINGLE 0
+#define CAMERA_DOUBLE_FLOAT 1
+#define CAMERA_FP64 2
+
+//variations blended by each entry, the first being the entry's own
+#define MAX_BLEND_VARIATIONS 4
+
+//affine maps are 3x4, rows of a, b, c, d for x', y' and z' = ax + by + cz + d
+#define TRANSFORM_VARIATIONS 0
+#define TRANSFORM_AFFINE 1
+#define AFFINE_MAP_SIZE 12
+
+#define DIMENSIONS_2D 0
+#define DIMENSIONS_3D 1
+
+#define SAMPLER_RANDOM 0
+#define SAMPLER_LOW_DISCREPANCY 1
+
+//points past this or non-finite are respawned
+#define ESCAPE_RADIUS 1e6f
+#define RESPAWN_ITERATIONS 8
+
+//indices into the statistics produceSamples gathers, selections has one count per entry
+#define STAT_RESPAWNS 0
+#define STAT_MERGED_HITS 1
+#define STAT_OFF_SCREEN 2
+#define STAT_NON_FINITE 3
+#define STAT_SELECTIONS 4
+#define NUM_STATS (STAT_SELECTIONS + MAX_VARIATIONS)
+
+//position (2), colour (3), rng seed (1), depth (1), entry history (1)
+#define POINT_STATE_SIZE 8
+
 #endif
\ No newline at end of file
@@ -2,6 +2,9 @@
 #include "ifs.h"
 
 #include <random>
+#include <future>
+#include <chrono>
+#include <unordered_map>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
@@ -10,9 +13,11 @@
 #define CL_MANAGER_IMPL
 #define CL_MANAGER_GL
 #include "CLManager.h"
+#include "Camera.h"
 #include "Camera2D.h"
 #include "ShaderProgram.h"
 #include "filedialog.h"
+#include "kernels.h"
 
 #include "common_def.h"
 
@@ -29,41 +34,166 @@ namespace ifs
 
 		std::string glb_previewTexture = "previewTexture";
 		std::string b_renderTexture = "renderTexture";
+		std::string b_renderChunkTexture = "renderChunkTexture";
 		std::string b_processedRenderTexture = "processedRenderTexture";
 		std::string b_variations = "variations";
 		std::string b_colours = "colours";
 		std::string b_weights = "weights";
+		std::string b_aliasProbabilities = "aliasProbabilities";
+		std::string b_aliasIndices = "aliasIndices";
+		std::string b_affineMaps = "affineMaps";
+		std::string b_depths = "depths";
+		std::string b_blendVariations = "blendVariations";
+		std::string b_blendWeights = "blendWeights";
+		std::string b_pointStates = "pointStates";
+		std::string b_renderPointStates = "renderPointStates";
+		std::string b_deferredRecords = "deferredRecords";
+		std::string b_deferredRecordsPlaceholder = "deferredRecordsPlaceholder";
+		std::string b_sortedDeferredRecords = "sortedDeferredRecords";
+		std::string b_bucketCounts = "bucketCounts";
+		std::string b_bucketOffsets = "bucketOffsets";
+		std::string b_bucketCursors = "bucketCursors";
+		std::string b_statistics = "statistics";
+		std::string b_extraViewMatrices = "extraViewMatrices";
+		std::string b_extraViewRects = "extraViewRects";
 		std::string k_produceSamples = "produceSamples";
 		std::string k_renderPostProcess = "renderPostProcess";
+		std::string k_countDeferredBuckets = "countDeferredBuckets";
+		std::string k_scatterDeferredRecords = "scatterDeferredRecords";
+		std::string k_reduceDeferredBuckets = "reduceDeferredBuckets";
+		std::string k_flushDeepAccumulation = "flushDeepAccumulation";
+		std::string k_benchmarkSelection = "benchmarkSelection";
+		std::string k_compareVariations = "compareVariations";
 		std::vector<cl::Memory> glObjectsToAcquire;
 
 		Camera2D cam;
+		Camera cam3D; //used instead of cam in the 3d mode
 		uint32_t previewTexWidth, previewTexHeight;
 		uint32_t renderTexWidth, renderTexHeight;
 		bool renderTransparency;
+		bool renderDeferredPlotting;
+		float renderSplatWidth;
+
+		//accumulation mode produceSamples uses for the current render, see chooseRenderAccumulation. with deep accumulation
+		//each launch goes to a fixed32 histogram which is added to the fixed64 format b_renderTexture afterwards
+		uint32_t renderAccumulationMode;
+		bool renderDeepAccumulation;
+
+		//extra framings plotted by renders in the same pass as the main image, each saved as its own image. centre is in
+		//the main image's 0-1 coordinates, and zoom is relative to the main image
+		struct RenderView
+		{
+			glm::vec2 centre;
+			float zoom;
+			uint32_t width, height;
+		};
+		std::vector<RenderView> renderViews;
 
 		uint32_t numPreviewSamples;
 		uint32_t totalPreviewSamples;
 		uint32_t numRenderSamples;
 		uint32_t initialIterations;
 		uint32_t iterations;
+		uint32_t symmetryOrder;
+		bool symmetryMirror;
 
 		bool clearEveryFrame;
 		bool clearSingleFrame;
+		bool resetPointStates;
 		bool paused;
 		bool renderMatchPreviewSampleNum;
 
 		float gamma;
 		float darkness;
 
+		uint32_t accumulationMode;
+		bool supportsFixed64;
+		uint32_t binningMode;
+		uint32_t selectionMode;
+		uint32_t executionMode;
+		uint32_t choiceMode;
+		uint32_t samplerMode;
+		uint32_t transformMode;
+		uint32_t dimensions;
+		float fogDensity;
+		uint32_t histogramLayout;
+		uint32_t cameraMode;
+		bool supportsFP64;
+
 		uint32_t numVariations;
 		uint32_t variations[MAX_VARIATIONS];
 		float coloursRGB[MAX_VARIATIONS * 3];
 		float coloursLCh[MAX_VARIATIONS * 3];
 		float weights[MAX_VARIATIONS];
+		float aliasProbabilities[MAX_VARIATIONS];
+		uint32_t aliasIndices[MAX_VARIATIONS];
+		float affineMaps[MAX_VARIATIONS * AFFINE_MAP_SIZE];
+		float depths[MAX_VARIATIONS];
+
+		//each entry applies a weighted sum of up to MAX_BLEND_VARIATIONS variations. slot 0 is the entry's own variation
+		//from variations, so blendVariations only uses slots 1 and up
+		uint32_t blendVariations[MAX_VARIATIONS * MAX_BLEND_VARIATIONS];
+		float blendWeights[MAX_VARIATIONS * MAX_BLEND_VARIATIONS];
+
+		//classic IFS for the affine transform mode, each map is the rows of x', y' and z' = ax + by + cz + d. the triangle
+		//halves points towards one of its corners, the carpet shrinks them into one of 8 squares of a 3x3 grid, and both
+		//flatten z. the tetrahedron halves points towards one of its corners in 3d
+		const float SIERPINSKI_TRIANGLE[] = {
+			0.5f, 0.0f, 0.0f, -0.5f, 0.0f, 0.5f, 0.0f, -0.375f, 0.0f, 0.0f, 0.0f, 0.0f,
+			0.5f, 0.0f, 0.0f, 0.5f, 0.0f, 0.5f, 0.0f, -0.375f, 0.0f, 0.0f, 0.0f, 0.0f,
+			0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.491f, 0.0f, 0.0f, 0.0f, 0.0f
+		};
+
+		const float SIERPINSKI_CARPET[] = {
+			1.0f / 3.0f, 0.0f, 0.0f, -2.0f / 3.0f, 0.0f, 1.0f / 3.0f, 0.0f, -2.0f / 3.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+			1.0f / 3.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f / 3.0f, 0.0f, -2.0f / 3.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+			1.0f / 3.0f, 0.0f, 0.0f, 2.0f / 3.0f, 0.0f, 1.0f / 3.0f, 0.0f, -2.0f / 3.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+			1.0f / 3.0f, 0.0f, 0.0f, -2.0f / 3.0f, 0.0f, 1.0f / 3.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+			1.0f / 3.0f, 0.0f, 0.0f, 2.0f / 3.0f, 0.0f, 1.0f / 3.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+			1.0f / 3.0f, 0.0f, 0.0f, -2.0f / 3.0f, 0.0f, 1.0f / 3.0f, 0.0f, 2.0f / 3.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+			1.0f / 3.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f / 3.0f, 0.0f, 2.0f / 3.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+			1.0f / 3.0f, 0.0f, 0.0f, 2.0f / 3.0f, 0.0f, 1.0f / 3.0f, 0.0f, 2.0f / 3.0f, 0.0f, 0.0f, 0.0f, 0.0f
+		};
+
+		const float SIERPINSKI_TETRAHEDRON[] = {
+			0.5f, 0.0f, 0.0f, 0.25f, 0.0f, 0.5f, 0.0f, 0.25f, 0.0f, 0.0f, 0.5f, 0.25f,
+			0.5f, 0.0f, 0.0f, 0.25f, 0.0f, 0.5f, 0.0f, -0.25f, 0.0f, 0.0f, 0.5f, -0.25f,
+			0.5f, 0.0f, 0.0f, -0.25f, 0.0f, 0.5f, 0.0f, 0.25f, 0.0f, 0.0f, 0.5f, -0.25f,
+			0.5f, 0.0f, 0.0f, -0.25f, 0.0f, 0.5f, 0.0f, -0.25f, 0.0f, 0.0f, 0.5f, 0.25f
+		};
+
+		//indexed by ACCUMULATION_* mode
+		const char* ACCUMULATION_NAMES[] = { "Float", "Fixed point 32 bit", "Fixed point 64 bit", "Per-entry colour",
+			"Packed RGB9E5", "Palette coordinate" };
 
 		uint32_t frameNum = 0;
 
+		//versions of produceSamples compiled for one set of variations, keyed with getProgramKey
+		struct SpecialisedProgram
+		{
+			bool success;
+			cl::Program program;
+		};
+		std::unordered_map<std::string, SpecialisedProgram> specialisedPrograms;
+		std::future<SpecialisedProgram> compilingProgram;
+		std::string compilingProgramKey;
+		std::string activeProgramKey; //empty when using the generic kernel
+		bool useSpecialisedKernels;
+		bool useFastVariations;
+
+		std::vector<std::string> benchmarkResults;
+
+		//counts from produceSamples, see STAT_* in common_def.h
+		uint32_t previewStatistics[NUM_STATS];
+		uint64_t renderStatistics[NUM_STATS];
+		bool countStatistics; //also gather the off screen, non-finite and selection counts
+
+		//renders are split into launches of this many sample points, which carry on iterating the same points
+		const uint32_t renderChunkSize = 1 << 20;
+
+		//records held at once when rendering with deferred plotting, 8 bytes each and stored twice for sorting
+		const uint32_t maxDeferredRecords = 1 << 24;
+
 		uint32_t VALID_VARIATIONS[] = {
 			0,
 			1,
@@ -122,9 +252,20 @@ namespace ifs
 
 		glObjectsToAcquire.clear();
 
-		//replace preview buffer
-		uint32_t numPixels = previewTexWidth * previewTexHeight;
-		CLManager::createGLBufferNoVAO<float>(glb_previewTexture, GL_SHADER_STORAGE_BUFFER, numPixels * 4);
+		//replace preview buffer. per-entry colour grows with the size and number of entries, and past the cap the preview
+		//goes back to fixed point colour
+		uint32_t numPixels = getHistogramPixelCount(previewTexWidth, previewTexHeight);
+		if (accumulationMode == ACCUMULATION_ENTRY_CHANNELS &&
+			getEntryChannelMB(numPixels) * getHistogramPixelSize(accumulationMode) > MAX_ENTRY_CHANNEL_MB)
+		{
+			std::cout << "Per-entry colour would need more than " << MAX_ENTRY_CHANNEL_MB << " MB, using fixed point 32 bit"
+				<< std::endl;
+			accumulationMode = ACCUMULATION_FIXED32;
+			CLManager::setKernelParamValue(k_produceSamples, 15, accumulationMode);
+			CLManager::setKernelParamValue(k_renderPostProcess, 6, accumulationMode);
+		}
+
+		CLManager::createGLBufferNoVAO<uint32_t>(glb_previewTexture, GL_SHADER_STORAGE_BUFFER, numPixels * getHistogramPixelSize(accumulationMode));
 
 		glUseProgram(shFullScreenTri.getID());
 		//use shader storage buffer as easier to work with between opencl and gl
@@ -135,7 +276,10 @@ namespace ifs
 
 		glUniform1ui(glGetUniformLocation(shFullScreenTri.getID(), "texWidth"), previewTexWidth);
 		glUniform1ui(glGetUniformLocation(shFullScreenTri.getID(), "texHeight"), previewTexHeight);
+		glUniform1ui(glGetUniformLocation(shFullScreenTri.getID(), "accumulationMode"), accumulationMode);
+		glUniform1ui(glGetUniformLocation(shFullScreenTri.getID(), "histogramLayout"), histogramLayout);
 		glUseProgram(0);
+		setPreviewEntryColours();
 
 		glObjectsToAcquire.push_back(CLManager::glBuffers[glb_previewTexture].clBuffer);
 
@@ -145,20 +289,107 @@ namespace ifs
 		CLManager::setKernelParamValue(k_produceSamples, 9, previewTexHeight);
 	}
 
+	void setPreviewEntryColours()
+	{
+		//colours the preview shader gives each channel of a per-entry colour histogram, or interpolates for palette
+		glUseProgram(shFullScreenTri.getID());
+		glUniform1ui(glGetUniformLocation(shFullScreenTri.getID(), "numEntries"), numVariations);
+		glUniform3fv(glGetUniformLocation(shFullScreenTri.getID(), "entryColours"), MAX_VARIATIONS, coloursRGB);
+		glUseProgram(0);
+	}
+
+	void setCameraKernelParams()
+	{
+		//give produceSamples the camera, with its position in the view matrix or passed separately for the deep zoom modes.
+		//the 3d camera's position is always in its matrix, and only it uses fog
+		if (dimensions == DIMENSIONS_3D)
+		{
+			CLManager::setKernelParamValue(k_produceSamples, 7, toCL(cam3D.getMatrixWorldToScreen()));
+			CLManager::setKernelParamValue(k_produceSamples, 42, CAMERA_SINGLE);
+			CLManager::setKernelParamValue(k_produceSamples, 43, vec4wrap{ 0.0f, 0.0f, 0.0f, 0.0f });
+			CLManager::setKernelParamValue(k_produceSamples, 51, fogDensity);
+			return;
+		}
+
+		CLManager::setKernelParamValue(k_produceSamples, 42, cameraMode);
+		CLManager::setKernelParamValue(k_produceSamples, 51, 0.0f);
+		if (cameraMode == CAMERA_SINGLE)
+		{
+			CLManager::setKernelParamValue(k_produceSamples, 7, cam.getMatViewCL());
+			CLManager::setKernelParamValue(k_produceSamples, 43, vec4wrap{ 0.0f, 0.0f, 0.0f, 0.0f });
+		}
+		else
+		{
+			CLManager::setKernelParamValue(k_produceSamples, 7, cam.getMatViewRelativeCL(cam.position));
+			CLManager::setKernelParamValue(k_produceSamples, 43, cam.getPositionCL());
+		}
+	}
+
+	void setCameraMode(uint32_t mode)
+	{
+		//how precisely the camera position is taken off plotted points
+		if (mode == CAMERA_FP64 && !supportsFP64)
+		{
+			std::cout << "Double precision is not supported on this device" << std::endl;
+			return;
+		}
+
+		cameraMode = mode;
+		setCameraKernelParams();
+		clearSingleFrame = true;
+	}
+
 	void updateCam(const glm::vec2& deltaPos, const float deltaZoom)
 	{
 		if (paused) return;
 
-		cam.updatePosition(deltaPos);
-		cam.updateView(deltaZoom);
-		CLManager::setKernelParamValue(k_produceSamples, 7, cam.getMatViewCL());
+		if (dimensions == DIMENSIONS_3D)
+		{
+			//the same controls move the 3d camera across its view, and zooming moves it forwards
+			glm::vec3 right = glm::normalize(glm::cross(cam3D.direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+			glm::vec3 up = glm::cross(right, cam3D.direction);
+			cam3D.updatePosition(right * deltaPos.x + up * deltaPos.y + cam3D.direction * (deltaZoom - 1.0f));
+		}
+		else
+		{
+			cam.updatePosition(deltaPos);
+			cam.updateView(deltaZoom);
+		}
+
+		setCameraKernelParams();
 		clearSingleFrame = true;
 	}
 
 	void resetCam()
 	{
 		cam.reset();
-		CLManager::setKernelParamValue(k_produceSamples, 7, cam.getMatViewCL());
+		cam3D.init(cam3D.ar, glm::vec3(0.0f, 0.0f, 2.0f));
+		setCameraKernelParams();
+		clearSingleFrame = true;
+	}
+
+	void setCamAngles(const glm::vec2& angles)
+	{
+		//pitch and yaw of the 3d camera, in radians
+		cam3D.updateViewAngle(angles - cam3D.angles);
+		setCameraKernelParams();
+		clearSingleFrame = true;
+	}
+
+	void setDimensions(uint32_t d)
+	{
+		//whether points have a depth and are plotted through the 3d camera
+		dimensions = d;
+		CLManager::setKernelParamValue(k_produceSamples, 48, dimensions);
+		setCameraKernelParams();
+		resetPointStates = true;
+		clearSingleFrame = true;
+	}
+
+	void setFogDensity(float density)
+	{
+		fogDensity = density;
+		setCameraKernelParams();
 		clearSingleFrame = true;
 	}
 
@@ -179,15 +410,21 @@ namespace ifs
 		previewTexHeight = height;
 		createPreviewTexture();
 		cam.setAspectRatio(previewTexWidth, previewTexHeight);
-		CLManager::setKernelParamValue(k_produceSamples, 7, cam.getMatViewCL());
+		cam3D.setAspectRatio(previewTexWidth, previewTexHeight);
+		setCameraKernelParams();
 	}
 
 	void setNumPreviewSamples(uint32_t n)
 	{
 		//set the number of sample points which will be calculated each frame for the preview
 		numPreviewSamples = n;
-		CLManager::setKernelRange(k_produceSamples, numPreviewSamples);
+		CLManager::setKernelRange(k_produceSamples, getNumWorkItems(numPreviewSamples));
 		CLManager::setKernelParamValue(k_produceSamples, 11, numPreviewSamples);
+
+		//each sample point keeps its position between frames
+		CLManager::createBuffer<float>(b_pointStates, std::max(numPreviewSamples, 1u) * POINT_STATE_SIZE);
+		CLManager::setKernelParamBuffer(k_produceSamples, 16, { b_pointStates });
+		resetPointStates = true;
 		clearSingleFrame = true;
 	}
 
@@ -196,6 +433,7 @@ namespace ifs
 		//number of iterations which will run on sample points before their positions are drawn to the buffer
 		initialIterations = n;
 		CLManager::setKernelParamValue(k_produceSamples, 5, initialIterations);
+		resetPointStates = true;
 		clearSingleFrame = true;
 	}
 
@@ -207,6 +445,16 @@ namespace ifs
 		clearSingleFrame = true;
 	}
 
+	void setSymmetry(uint32_t order, bool mirror)
+	{
+		//each plotted point is drawn rotated order times about the origin, and mirrored as well if mirror is set
+		symmetryOrder = order;
+		symmetryMirror = mirror;
+		CLManager::setKernelParamValue(k_produceSamples, 35, symmetryOrder);
+		CLManager::setKernelParamValue(k_produceSamples, 36, (uint8_t)symmetryMirror);
+		clearSingleFrame = true;
+	}
+
 	void setGamma(float g)
 	{
 		//pixel values will be raised to power of 1/gamma
@@ -227,6 +475,135 @@ namespace ifs
 		CLManager::setKernelParamValue(k_renderPostProcess, 3, 1.0f / darkness);
 	}
 
+	void setAccumulationMode(uint32_t mode)
+	{
+		//how the histogram is stored. fixed point modes are faster and give identical results every run
+		if (mode == ACCUMULATION_FIXED64 && !supportsFixed64)
+		{
+			std::cout << "64 bit accumulation is not supported on this device" << std::endl;
+			return;
+		}
+
+		accumulationMode = mode;
+		CLManager::setKernelParamValue(k_produceSamples, 15, accumulationMode);
+		CLManager::setKernelParamValue(k_renderPostProcess, 6, accumulationMode);
+		setPreviewBinningParam();
+
+		//pixel size depends on the mode, so the preview buffer needs replacing
+		createPreviewTexture();
+		clearSingleFrame = true;
+	}
+
+	void setBinningMode(uint32_t mode)
+	{
+		//whether samples go straight to the histogram or are collected in each work group's local memory first
+		binningMode = mode;
+		setPreviewBinningParam();
+	}
+
+	void setPreviewBinningParam()
+	{
+		//packed rgb rounds the pixel's whole sum every time something is added to it, so its samples are always summed in
+		//the local cache first to round less often
+		CLManager::setKernelParamValue(k_produceSamples, 18,
+			accumulationMode == ACCUMULATION_PACKED_RGB ? (uint32_t)BINNING_LOCAL_CACHE : binningMode);
+	}
+
+	void setSelectionMode(uint32_t mode)
+	{
+		//how F picks a variation, both give the same distribution, including all entries equally when every weight is 0
+		selectionMode = mode;
+		CLManager::setKernelParamValue(k_produceSamples, 25, selectionMode);
+	}
+
+	void setExecutionMode(uint32_t mode)
+	{
+		//whether points are regrouped by chosen variation before applying it, both give the same result
+		executionMode = mode;
+		CLManager::setKernelParamValue(k_produceSamples, 27, executionMode);
+	}
+
+	void setChoiceMode(uint32_t mode)
+	{
+		//whether each sample point picks its own variation, or every point in a work group picks the same one
+		choiceMode = mode;
+		CLManager::setKernelParamValue(k_produceSamples, 31, choiceMode);
+		resetPointStates = true;
+		clearSingleFrame = true;
+	}
+
+	void setSamplerMode(uint32_t mode)
+	{
+		//how start points and variation choices are generated
+		samplerMode = mode;
+		CLManager::setKernelParamValue(k_produceSamples, 34, samplerMode);
+		resetPointStates = true;
+		clearSingleFrame = true;
+	}
+
+	void setTransformMode(uint32_t mode)
+	{
+		//whether the variation list applies variations or affine maps
+		transformMode = mode;
+		CLManager::setKernelParamValue(k_produceSamples, 44, transformMode);
+		resetPointStates = true;
+		clearSingleFrame = true;
+	}
+
+	void setCountStatistics(bool count)
+	{
+		countStatistics = count;
+		CLManager::setKernelParamValue(k_produceSamples, 47, (uint8_t)countStatistics);
+		for (uint32_t i = 0; i < NUM_STATS; i++) previewStatistics[i] = 0;
+
+		//the preview doesn't read the counts while this is off, so drop what built up in the meantime
+		CLManager::fillBuffer<uint32_t>(b_statistics, NUM_STATS, 0);
+	}
+
+	void setHistogramLayout(uint32_t layout)
+	{
+		//how pixels are arranged in the histogram, which changes its size so the preview buffer needs replacing
+		histogramLayout = layout;
+		CLManager::setKernelParamValue(k_produceSamples, 41, histogramLayout);
+		CLManager::setKernelParamValue(k_renderPostProcess, 10, histogramLayout);
+		createPreviewTexture();
+		clearSingleFrame = true;
+	}
+
+	uint32_t getHistogramPixelCount(uint32_t width, uint32_t height)
+	{
+		//pixels stored for an image of this size, including the padding to whole tiles in the tiled layout
+		if (histogramLayout == LAYOUT_TILED)
+		{
+			uint32_t tilesX = (width + HISTOGRAM_TILE_SIZE - 1) / HISTOGRAM_TILE_SIZE;
+			uint32_t tilesY = (height + HISTOGRAM_TILE_SIZE - 1) / HISTOGRAM_TILE_SIZE;
+			return tilesX * tilesY * HISTOGRAM_TILE_SIZE * HISTOGRAM_TILE_SIZE;
+		}
+
+		return width * height;
+	}
+
+	uint32_t getNumWorkItems(uint32_t numSamples)
+	{
+		//each work item of produceSamples iterates CHAINS_PER_ITEM sample points
+		return (numSamples + CHAINS_PER_ITEM - 1) / CHAINS_PER_ITEM;
+	}
+
+	uint32_t getHistogramPixelSize(uint32_t mode)
+	{
+		//number of 32 bit values used for each pixel of a histogram accumulated with this mode. per-entry colour has one
+		//channel for each entry of the variation list, packed rgb and palette have a colour value and a count
+		if (mode == ACCUMULATION_ENTRY_CHANNELS) return std::max(numVariations, 1u);
+		if (mode == ACCUMULATION_PACKED_RGB || mode == ACCUMULATION_PALETTE) return 2;
+		return mode == ACCUMULATION_FIXED64 ? 8 : 4;
+	}
+
+	float getEntryChannelMB(uint32_t numPixels)
+	{
+		//memory used by each entry's channel in a per-entry colour histogram of numPixels
+		return (float)numPixels * sizeof(uint32_t) / (float)(1 << 20);
+	}
+
 	void addDefaultVariation()
 	{
 		//shortcut for adding a new variation with some parameters
@@ -238,8 +615,19 @@ namespace ifs
 			setVariationNum(index, 0);
 			setVariationColour(index, 1.0f, 0.0f, 0.0f);
 			setVariationWeight(index, 1.0f);
+			float map[AFFINE_MAP_SIZE] = { 0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f };
+			setAffineMap(index, map);
+			setVariationDepth(index, 0.0f);
+			for (uint32_t b = 0; b < MAX_BLEND_VARIATIONS; b++)
+			{
+				if (b > 0) setBlendVariation(index, b, 0);
+				setBlendWeight(index, b, b == 0 ? 1.0f : 0.0f);
+			}
 
 			CLManager::setKernelParamValue(k_produceSamples, 4, numVariations);
+			if (accumulationMode == ACCUMULATION_ENTRY_CHANNELS) createPreviewTexture();
+			else setPreviewEntryColours();
+			resetPointStates = true;
 			clearSingleFrame = true;
 		}
 	}
@@ -256,8 +644,18 @@ namespace ifs
 			float* col = randomOKLCh();
 			setVariationColour(index, col[0], col[1], col[2]);
 			setVariationWeight(index, randomFloat());
+			setAffineMap(index, randomAffineMap());
+			setVariationDepth(index, randomFloat() * 2.0f - 1.0f);
+			for (uint32_t b = 0; b < MAX_BLEND_VARIATIONS; b++)
+			{
+				if (b > 0) setBlendVariation(index, b, 0);
+				setBlendWeight(index, b, b == 0 ? 1.0f : 0.0f);
+			}
 
 			CLManager::setKernelParamValue(k_produceSamples, 4, numVariations);
+			if (accumulationMode == ACCUMULATION_ENTRY_CHANNELS) createPreviewTexture();
+			else setPreviewEntryColours();
+			resetPointStates = true;
 			clearSingleFrame = true;
 		}
 	}
@@ -272,6 +670,16 @@ namespace ifs
 			coloursRGB[j * 3 + 1] = coloursRGB[(j + 1) * 3 + 1];
 			coloursRGB[j * 3 + 2] = coloursRGB[(j + 1) * 3 + 2];
 			weights[j] = weights[j + 1];
+			depths[j] = depths[j + 1];
+			for (uint32_t k = 0; k < AFFINE_MAP_SIZE; k++)
+			{
+				affineMaps[j * AFFINE_MAP_SIZE + k] = affineMaps[(j + 1) * AFFINE_MAP_SIZE + k];
+			}
+			for (uint32_t b = 0; b < MAX_BLEND_VARIATIONS; b++)
+			{
+				blendVariations[j * MAX_BLEND_VARIATIONS + b] = blendVariations[(j + 1) * MAX_BLEND_VARIATIONS + b];
+				blendWeights[j * MAX_BLEND_VARIATIONS + b] = blendWeights[(j + 1) * MAX_BLEND_VARIATIONS + b];
+			}
 		}
 
 		numVariations--;
@@ -287,26 +695,34 @@ namespace ifs
 		CLManager::writeBuffer(b_variations, MAX_VARIATIONS, variations);
 		CLManager::writeBuffer(b_colours, MAX_VARIATIONS * 3, coloursRGB);
 		CLManager::writeBuffer(b_weights, MAX_VARIATIONS, weights);
+		CLManager::writeBuffer(b_affineMaps, MAX_VARIATIONS * AFFINE_MAP_SIZE, affineMaps);
+		CLManager::writeBuffer(b_depths, MAX_VARIATIONS, depths);
+		CLManager::writeBuffer(b_blendVariations, MAX_VARIATIONS * MAX_BLEND_VARIATIONS, blendVariations);
+		CLManager::writeBuffer(b_blendWeights, MAX_VARIATIONS * MAX_BLEND_VARIATIONS, blendWeights);
 		CLManager::setKernelParamValue(k_produceSamples, 4, numVariations);
+		updateAliasTable();
+		if (accumulationMode == ACCUMULATION_ENTRY_CHANNELS) createPreviewTexture();
+		else setPreviewEntryColours();
 
+		resetPointStates = true;
 		clearSingleFrame = true;
 	}
 
-	void setVariationNum(uint32_t index, uint32_t variation)
+	bool isValidVariation(uint32_t variation)
 	{
-		if (index >= numVariations) return;
-
-		bool valid = false;
 		for (uint32_t i = 0; i < IM_ARRAYSIZE(VALID_VARIATIONS); i++)
 		{
-			if (variation == VALID_VARIATIONS[i])
-			{
-				valid = true;
-				break;
-			}
+			if (variation == VALID_VARIATIONS[i]) return true;
 		}
 
-		if (!valid)
+		return false;
+	}
+
+	void setVariationNum(uint32_t index, uint32_t variation)
+	{
+		if (index >= numVariations) return;
+
+		if (!isValidVariation(variation))
 		{
 			std::cout << "Tried to set invalid variation: " << variation << std::endl;
 			return;
@@ -314,6 +730,7 @@ namespace ifs
 
 		variations[index] = variation;
 		CLManager::writeBuffer(b_variations, 1, &variations[index], index);
+		resetPointStates = true;
 		clearSingleFrame = true;
 	}
 
@@ -331,7 +748,10 @@ namespace ifs
 		coloursRGB[index * 3 + 2] = rgb[2];
 
 		CLManager::writeBuffer(b_colours, 3, &coloursRGB[index * 3], index * 3);
-		clearSingleFrame = true;
+		setPreviewEntryColours();
+
+		//per-entry colour and palette apply the colours when drawing, so keep their samples
+		if (accumulationMode != ACCUMULATION_ENTRY_CHANNELS && accumulationMode != ACCUMULATION_PALETTE) clearSingleFrame = true;
 	}
 
 	void setVariationWeight(uint32_t index, float w)
@@ -340,9 +760,140 @@ namespace ifs
 		
 		weights[index] = w;
 		CLManager::writeBuffer(b_weights, 1, &weights[index], index);
+		updateAliasTable();
+		resetPointStates = true;
+		clearSingleFrame = true;
+	}
+
+	void setBlendVariation(uint32_t index, uint32_t slot, uint32_t variation)
+	{
+		//slot 0 is the entry's own variation, set with setVariationNum. the kernel takes it from variations, so it's
+		//refused here rather than left different between the host array and the buffer
+		if (index >= numVariations || slot == 0 || slot >= MAX_BLEND_VARIATIONS) return;
+
+		if (!isValidVariation(variation))
+		{
+			std::cout << "Tried to set invalid blend variation: " << variation << std::endl;
+			return;
+		}
+
+		uint32_t i = index * MAX_BLEND_VARIATIONS + slot;
+		blendVariations[i] = variation;
+		CLManager::writeBuffer(b_blendVariations, 1, &blendVariations[i], i);
+		resetPointStates = true;
+		clearSingleFrame = true;
+	}
+
+	void setBlendWeight(uint32_t index, uint32_t slot, float w)
+	{
+		//how much of the variation in this slot goes into the entry's sum, slots with no weight aren't evaluated
+		if (index >= numVariations || slot >= MAX_BLEND_VARIATIONS) return;
+
+		uint32_t i = index * MAX_BLEND_VARIATIONS + slot;
+		blendWeights[i] = w;
+		CLManager::writeBuffer(b_blendWeights, 1, &blendWeights[i], i);
+		resetPointStates = true;
+		clearSingleFrame = true;
+	}
+
+	void setVariationDepth(uint32_t index, float d)
+	{
+		//depth the entry pulls points towards in the 3d mode
+		if (index >= numVariations) return;
+
+		depths[index] = d;
+		CLManager::writeBuffer(b_depths, 1, &depths[index], index);
+		resetPointStates = true;
+		clearSingleFrame = true;
+	}
+
+	void setAffineMap(uint32_t index, const float* map)
+	{
+		if (index >= numVariations) return;
+
+		for (uint32_t i = 0; i < AFFINE_MAP_SIZE; i++)
+		{
+			affineMaps[index * AFFINE_MAP_SIZE + i] = map[i];
+		}
+
+		CLManager::writeBuffer(b_affineMaps, AFFINE_MAP_SIZE, &affineMaps[index * AFFINE_MAP_SIZE], index * AFFINE_MAP_SIZE);
+		resetPointStates = true;
 		clearSingleFrame = true;
 	}
 
+	void loadAffinePreset(const float* maps, uint32_t n)
+	{
+		//replace the variation list with n equally weighted affine maps with random colours, and switch to affine mode
+		numVariations = 0;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			addRandomVariation();
+			setVariationWeight(i, 1.0f);
+			setAffineMap(i, &maps[i * AFFINE_MAP_SIZE]);
+		}
+
+		setTransformMode(TRANSFORM_AFFINE);
+	}
+
+	void buildAliasTable(const float* w, uint32_t n, float* probabilities, uint32_t* aliases)
+	{
+		//Vose's alias method. each slot keeps its own index with some probability and gives the rest to one alias, so
+		//picking a slot uniformly then choosing between the two gives the same distribution as the weights
+		float total = 0.0f;
+		for (uint32_t i = 0; i < n; i++) total += std::max(w[i], 0.0f);
+
+		float scaled[MAX_VARIATIONS];
+		uint32_t small[MAX_VARIATIONS];
+		uint32_t large[MAX_VARIATIONS];
+		uint32_t numSmall = 0;
+		uint32_t numLarge = 0;
+
+		for (uint32_t i = 0; i < n; i++)
+		{
+			//all zero weights are treated as equal, rather than never picking anything
+			scaled[i] = total > 0.0f ? std::max(w[i], 0.0f) * n / total : 1.0f;
+			if (scaled[i] < 1.0f) small[numSmall++] = i;
+			else large[numLarge++] = i;
+		}
+
+		while (numSmall > 0 && numLarge > 0)
+		{
+			uint32_t s = small[--numSmall];
+			uint32_t l = large[--numLarge];
+
+			probabilities[s] = scaled[s];
+			aliases[s] = l;
+
+			//l fills the rest of slot s, whatever is left of it still needs a slot
+			scaled[l] -= 1.0f - scaled[s];
+			if (scaled[l] < 1.0f) small[numSmall++] = l;
+			else large[numLarge++] = l;
+		}
+
+		//anything left over is only off from 1 by rounding error
+		while (numLarge > 0)
+		{
+			uint32_t l = large[--numLarge];
+			probabilities[l] = 1.0f;
+			aliases[l] = l;
+		}
+
+		while (numSmall > 0)
+		{
+			uint32_t s = small[--numSmall];
+			probabilities[s] = 1.0f;
+			aliases[s] = s;
+		}
+	}
+
+	void updateAliasTable()
+	{
+		//rebuild from the current weights whenever they change
+		buildAliasTable(weights, numVariations, aliasProbabilities, aliasIndices);
+		CLManager::writeBuffer(b_aliasProbabilities, MAX_VARIATIONS, aliasProbabilities);
+		CLManager::writeBuffer(b_aliasIndices, MAX_VARIATIONS, aliasIndices);
+	}
+
 	void createGUI()
 	{
 		#define IMGUI_SPACER ImGui::Dummy(ImVec2(0.0f, 10.0f));
@@ -368,6 +919,18 @@ namespace ifs
 			setIterations(std::max(temp, 0));
 		}
 
+		temp = symmetryOrder;
+		if (ImGui::InputInt("Rotational symmetry", &temp))
+		{
+			setSymmetry(std::max(temp, 1), symmetryMirror);
+		}
+
+		bool mirror = symmetryMirror;
+		if (ImGui::Checkbox("Mirror symmetry", &mirror))
+		{
+			setSymmetry(symmetryOrder, mirror);
+		}
+
 		float g = gamma;
 		if (ImGui::DragFloat("Gamma", &g, 0.01f, 0.00001f, 10.0f))
 		{
@@ -380,57 +943,341 @@ namespace ifs
 			setDarkness(d);
 		}
 
-		ImGui::Checkbox("Clear every frame", &clearEveryFrame);
-
-		if (ImGui::Button("Clear image"))
+		if (ImGui::BeginCombo("Accumulation", ACCUMULATION_NAMES[accumulationMode]))
 		{
-			clearSingleFrame = true;
+			for (uint32_t i = 0; i < IM_ARRAYSIZE(ACCUMULATION_NAMES); i++)
+			{
+				if (i == ACCUMULATION_FIXED64 && !supportsFixed64) continue;
+
+				bool is_selected = accumulationMode == i;
+				if (ImGui::Selectable(ACCUMULATION_NAMES[i], is_selected))
+				{
+					setAccumulationMode(i);
+				}
+				if (is_selected)
+				{
+					ImGui::SetItemDefaultFocus();
+				}
+			}
+			ImGui::EndCombo();
 		}
 
-		if (ImGui::Button("Reset camera"))
+		if (accumulationMode == ACCUMULATION_ENTRY_CHANNELS)
 		{
-			resetCam();
+			float channelMB = getEntryChannelMB(getHistogramPixelCount(previewTexWidth, previewTexHeight));
+			ImGui::Text("%u channels x %.1f MB = %.1f MB (max %d MB)", getHistogramPixelSize(accumulationMode), channelMB,
+				channelMB * getHistogramPixelSize(accumulationMode), MAX_ENTRY_CHANNEL_MB);
 		}
-
-		if (ImGui::Button(paused ? "Resume" : "Pause"))
+		else
 		{
-			paused = !paused;
+			ImGui::Text("%u bytes per pixel", getHistogramPixelSize(accumulationMode) * (uint32_t)sizeof(uint32_t));
 		}
 
-		IMGUI_SPACER
-
-		ImGui::SeparatorText("Variations");
-
-		for (uint32_t i = 0; i < numVariations; i++)
+		const char* binningNames[] = { "Direct", "Local cache" };
+		if (ImGui::BeginCombo("Binning", binningNames[binningMode]))
 		{
-			ImGui::PushID(i);
-
-			if (ImGui::BeginCombo("Variation", std::to_string(variations[i]).c_str()))
+			for (uint32_t i = 0; i < IM_ARRAYSIZE(binningNames); i++)
 			{
-				for (uint32_t j = 0; j < IM_ARRAYSIZE(VALID_VARIATIONS); j++)
+				bool is_selected = binningMode == i;
+				if (ImGui::Selectable(binningNames[i], is_selected))
 				{
-					bool is_selected = variations[i] == VALID_VARIATIONS[j];
-					if (ImGui::Selectable(std::to_string(VALID_VARIATIONS[j]).c_str(), is_selected))
-					{
-						setVariationNum(i, VALID_VARIATIONS[j]);
-					}
-					if (is_selected)
-					{
-						ImGui::SetItemDefaultFocus();
-					}
+					setBinningMode(i);
+				}
+				if (is_selected)
+				{
+					ImGui::SetItemDefaultFocus();
 				}
-				ImGui::EndCombo();
 			}
+			ImGui::EndCombo();
+		}
 
-			//can't use sliderfloat3 as each value has a different range
-			ImGui::PushItemWidth(90.0f);
-			if (ImGui::SliderFloat("##L", &coloursLCh[i * 3], 0.0f, 1.0f))
+		const char* selectionNames[] = { "Linear", "Alias table" };
+		if (ImGui::BeginCombo("Selection", selectionNames[selectionMode]))
+		{
+			for (uint32_t i = 0; i < IM_ARRAYSIZE(selectionNames); i++)
 			{
-				coloursLCh[i * 3] = glm::clamp(coloursLCh[i * 3], 0.0f, 1.0f);
-				setVariationColour(i, coloursLCh[i * 3], coloursLCh[i * 3 + 1], coloursLCh[i * 3 + 2]);
+				bool is_selected = selectionMode == i;
+				if (ImGui::Selectable(selectionNames[i], is_selected))
+				{
+					setSelectionMode(i);
+				}
+				if (is_selected)
+				{
+					ImGui::SetItemDefaultFocus();
+				}
 			}
-			ImGui::SameLine();
-			if (ImGui::SliderFloat("##C", &coloursLCh[i * 3 + 1], 0.0f, 0.5f))
+			ImGui::EndCombo();
+		}
+
+		const char* executionNames[] = { "Direct", "Regrouped" };
+		if (ImGui::BeginCombo("Execution", executionNames[executionMode]))
+		{
+			for (uint32_t i = 0; i < IM_ARRAYSIZE(executionNames); i++)
+			{
+				bool is_selected = executionMode == i;
+				if (ImGui::Selectable(executionNames[i], is_selected))
+				{
+					setExecutionMode(i);
+				}
+				if (is_selected)
+				{
+					ImGui::SetItemDefaultFocus();
+				}
+			}
+			ImGui::EndCombo();
+		}
+
+		const char* choiceNames[] = { "Independent", "Shared" };
+		if (ImGui::BeginCombo("Choice", choiceNames[choiceMode]))
+		{
+			for (uint32_t i = 0; i < IM_ARRAYSIZE(choiceNames); i++)
+			{
+				bool is_selected = choiceMode == i;
+				if (ImGui::Selectable(choiceNames[i], is_selected))
+				{
+					setChoiceMode(i);
+				}
+				if (is_selected)
+				{
+					ImGui::SetItemDefaultFocus();
+				}
+			}
+			ImGui::EndCombo();
+		}
+
+		const char* samplerNames[] = { "Random", "Low discrepancy" };
+		if (ImGui::BeginCombo("Sampler", samplerNames[samplerMode]))
+		{
+			for (uint32_t i = 0; i < IM_ARRAYSIZE(samplerNames); i++)
+			{
+				bool is_selected = samplerMode == i;
+				if (ImGui::Selectable(samplerNames[i], is_selected))
+				{
+					setSamplerMode(i);
+				}
+				if (is_selected)
+				{
+					ImGui::SetItemDefaultFocus();
+				}
+			}
+			ImGui::EndCombo();
+		}
+
+		const char* transformNames[] = { "Variations", "Affine maps" };
+		if (ImGui::BeginCombo("Transforms", transformNames[transformMode]))
+		{
+			for (uint32_t i = 0; i < IM_ARRAYSIZE(transformNames); i++)
+			{
+				bool is_selected = transformMode == i;
+				if (ImGui::Selectable(transformNames[i], is_selected))
+				{
+					setTransformMode(i);
+				}
+				if (is_selected)
+				{
+					ImGui::SetItemDefaultFocus();
+				}
+			}
+			ImGui::EndCombo();
+		}
+
+		const char* layoutNames[] = { "Linear", "8x8 tiles" };
+		if (ImGui::BeginCombo("Histogram layout", layoutNames[histogramLayout]))
+		{
+			for (uint32_t i = 0; i < IM_ARRAYSIZE(layoutNames); i++)
+			{
+				bool is_selected = histogramLayout == i;
+				if (ImGui::Selectable(layoutNames[i], is_selected))
+				{
+					setHistogramLayout(i);
+				}
+				if (is_selected)
+				{
+					ImGui::SetItemDefaultFocus();
+				}
+			}
+			ImGui::EndCombo();
+		}
+
+		const char* dimensionNames[] = { "2D", "3D" };
+		if (ImGui::BeginCombo("Dimensions", dimensionNames[dimensions]))
+		{
+			for (uint32_t i = 0; i < IM_ARRAYSIZE(dimensionNames); i++)
+			{
+				bool is_selected = dimensions == i;
+				if (ImGui::Selectable(dimensionNames[i], is_selected))
+				{
+					setDimensions(i);
+				}
+				if (is_selected)
+				{
+					ImGui::SetItemDefaultFocus();
+				}
+			}
+			ImGui::EndCombo();
+		}
+
+		if (dimensions == DIMENSIONS_3D)
+		{
+			glm::vec2 angles = glm::degrees(cam3D.angles);
+			bool anglesChanged = ImGui::SliderFloat("Camera pitch", &angles.x, -89.0f, 89.0f);
+			anglesChanged |= ImGui::SliderFloat("Camera yaw", &angles.y, 0.0f, 360.0f);
+			if (anglesChanged)
+			{
+				setCamAngles(glm::radians(angles));
+			}
+
+			float fog = fogDensity;
+			if (ImGui::SliderFloat("Fog density", &fog, 0.0f, 2.0f))
+			{
+				setFogDensity(fog);
+			}
+		}
+
+		const char* cameraNames[] = { "Single", "Double-float", "FP64" };
+		if (ImGui::BeginCombo("Camera precision", cameraNames[cameraMode]))
+		{
+			for (uint32_t i = 0; i < IM_ARRAYSIZE(cameraNames); i++)
+			{
+				if (i == CAMERA_FP64 && !supportsFP64) continue;
+
+				bool is_selected = cameraMode == i;
+				if (ImGui::Selectable(cameraNames[i], is_selected))
+				{
+					setCameraMode(i);
+				}
+				if (is_selected)
+				{
+					ImGui::SetItemDefaultFocus();
+				}
+			}
+			ImGui::EndCombo();
+		}
+
+		ImGui::Checkbox("Specialised kernels", &useSpecialisedKernels);
+
+		ImGui::Checkbox("Fast maths variations", &useFastVariations);
+
+		ImGui::Checkbox("Clear every frame", &clearEveryFrame);
+
+		if (ImGui::Button("Clear image"))
+		{
+			clearSingleFrame = true;
+		}
+
+		if (ImGui::Button("Reset camera"))
+		{
+			resetCam();
+		}
+
+		if (ImGui::Button(paused ? "Resume" : "Pause"))
+		{
+			paused = !paused;
+		}
+
+		if (ImGui::Checkbox("Detailed statistics", &countStatistics))
+		{
+			setCountStatistics(countStatistics);
+		}
+
+		if (countStatistics)
+		{
+			ImGui::Text("Respawned points per frame: %u", previewStatistics[STAT_RESPAWNS]);
+			ImGui::Text("Merged plot hits per frame: %u", previewStatistics[STAT_MERGED_HITS]);
+			uint64_t plotsPerFrame = (uint64_t)numPreviewSamples * std::max(iterations, 1u) * symmetryOrder *
+				(symmetryMirror ? 2 : 1);
+			ImGui::Text("Off-screen plots per frame: %u (%.1f%%)", previewStatistics[STAT_OFF_SCREEN],
+				plotsPerFrame > 0 ? 100.0f * previewStatistics[STAT_OFF_SCREEN] / plotsPerFrame : 0.0f);
+			ImGui::Text("Non-finite points per frame: %u", previewStatistics[STAT_NON_FINITE]);
+		}
+
+		IMGUI_SPACER
+
+		ImGui::SeparatorText("Variations");
+
+		for (uint32_t i = 0; i < numVariations; i++)
+		{
+			ImGui::PushID(i);
+
+			if (transformMode == TRANSFORM_AFFINE)
+			{
+				float map[AFFINE_MAP_SIZE];
+				for (uint32_t k = 0; k < AFFINE_MAP_SIZE; k++) map[k] = affineMaps[i * AFFINE_MAP_SIZE + k];
+
+				bool changed = ImGui::InputFloat4("x' = ax + by + cz + d", &map[0]);
+				changed |= ImGui::InputFloat4("y' = ax + by + cz + d", &map[4]);
+				if (dimensions == DIMENSIONS_3D) changed |= ImGui::InputFloat4("z' = ax + by + cz + d", &map[8]);
+				if (changed)
+				{
+					setAffineMap(i, map);
+				}
+			}
+			else if (ImGui::BeginCombo("Variation", std::to_string(variations[i]).c_str()))
+			{
+				for (uint32_t j = 0; j < IM_ARRAYSIZE(VALID_VARIATIONS); j++)
+				{
+					bool is_selected = variations[i] == VALID_VARIATIONS[j];
+					if (ImGui::Selectable(std::to_string(VALID_VARIATIONS[j]).c_str(), is_selected))
+					{
+						setVariationNum(i, VALID_VARIATIONS[j]);
+					}
+					if (is_selected)
+					{
+						ImGui::SetItemDefaultFocus();
+					}
+				}
+				ImGui::EndCombo();
+			}
+
+			if (transformMode == TRANSFORM_VARIATIONS && ImGui::CollapsingHeader("Blend"))
+			{
+				float w0 = blendWeights[i * MAX_BLEND_VARIATIONS];
+				if (ImGui::SliderFloat("Amount", &w0, 0.0f, 1.0f))
+				{
+					setBlendWeight(i, 0, w0);
+				}
+
+				for (uint32_t b = 1; b < MAX_BLEND_VARIATIONS; b++)
+				{
+					ImGui::PushID(b);
+					uint32_t& v = blendVariations[i * MAX_BLEND_VARIATIONS + b];
+					ImGui::PushItemWidth(90.0f);
+					if (ImGui::BeginCombo("##Blend variation", std::to_string(v).c_str()))
+					{
+						for (uint32_t j = 0; j < IM_ARRAYSIZE(VALID_VARIATIONS); j++)
+						{
+							bool is_selected = v == VALID_VARIATIONS[j];
+							if (ImGui::Selectable(std::to_string(VALID_VARIATIONS[j]).c_str(), is_selected))
+							{
+								setBlendVariation(i, b, VALID_VARIATIONS[j]);
+							}
+							if (is_selected)
+							{
+								ImGui::SetItemDefaultFocus();
+							}
+						}
+						ImGui::EndCombo();
+					}
+					ImGui::PopItemWidth();
+					ImGui::SameLine();
+					float bw = blendWeights[i * MAX_BLEND_VARIATIONS + b];
+					if (ImGui::SliderFloat("Amount", &bw, 0.0f, 1.0f))
+					{
+						setBlendWeight(i, b, bw);
+					}
+					ImGui::PopID();
+				}
+			}
+
+			//can't use sliderfloat3 as each value has a different range
+			ImGui::PushItemWidth(90.0f);
+			if (ImGui::SliderFloat("##L", &coloursLCh[i * 3], 0.0f, 1.0f))
+			{
+				coloursLCh[i * 3] = glm::clamp(coloursLCh[i * 3], 0.0f, 1.0f);
+				setVariationColour(i, coloursLCh[i * 3], coloursLCh[i * 3 + 1], coloursLCh[i * 3 + 2]);
+			}
+			ImGui::SameLine();
+			if (ImGui::SliderFloat("##C", &coloursLCh[i * 3 + 1], 0.0f, 0.5f))
 			{
 				coloursLCh[i * 3 + 1] = glm::clamp(coloursLCh[i * 3 + 1], 0.0f, 1.0f);
 				setVariationColour(i, coloursLCh[i * 3], coloursLCh[i * 3 + 1], coloursLCh[i * 3 + 2]);
@@ -452,6 +1299,24 @@ namespace ifs
 				setVariationWeight(i, w);
 			}			
 
+			//affine maps move z themselves
+			if (dimensions == DIMENSIONS_3D && transformMode == TRANSFORM_VARIATIONS)
+			{
+				float d = depths[i];
+				if (ImGui::SliderFloat("Depth", &d, -1.0f, 1.0f))
+				{
+					setVariationDepth(i, d);
+				}
+			}
+
+			if (countStatistics)
+			{
+				uint64_t totalSelections = 0;
+				for (uint32_t j = 0; j < numVariations; j++) totalSelections += previewStatistics[STAT_SELECTIONS + j];
+				ImGui::Text("Chosen by %.1f%% of iterations", totalSelections > 0 ?
+					100.0f * previewStatistics[STAT_SELECTIONS + i] / totalSelections : 0.0f);
+			}
+
 			if (ImGui::Button("Remove"))
 			{
 				removeVariation(i);
@@ -501,6 +1366,39 @@ namespace ifs
 			}
 		}
 
+		if (transformMode == TRANSFORM_AFFINE)
+		{
+			if (ImGui::Button("Randomise maps"))
+			{
+				for (uint32_t i = 0; i < numVariations; i++)
+				{
+					setAffineMap(i, randomAffineMap());
+				}
+			}
+
+			ImGui::SameLine();
+		}
+
+		if (ImGui::Button("Sierpinski triangle"))
+		{
+			loadAffinePreset(SIERPINSKI_TRIANGLE, IM_ARRAYSIZE(SIERPINSKI_TRIANGLE) / AFFINE_MAP_SIZE);
+		}
+
+		ImGui::SameLine();
+
+		if (ImGui::Button("Sierpinski carpet"))
+		{
+			loadAffinePreset(SIERPINSKI_CARPET, IM_ARRAYSIZE(SIERPINSKI_CARPET) / AFFINE_MAP_SIZE);
+		}
+
+		ImGui::SameLine();
+
+		if (ImGui::Button("Sierpinski tetrahedron"))
+		{
+			loadAffinePreset(SIERPINSKI_TETRAHEDRON, IM_ARRAYSIZE(SIERPINSKI_TETRAHEDRON) / AFFINE_MAP_SIZE);
+			setDimensions(DIMENSIONS_3D);
+		}
+
 		ImGui::End();
 
 		ImGui::Begin("Render");
@@ -527,90 +1425,314 @@ namespace ifs
 		}
 
 		ImGui::Checkbox("Transparent background", &renderTransparency);
+		ImGui::Checkbox("Deferred plotting", &renderDeferredPlotting);
+		ImGui::SliderFloat("Splat width", &renderSplatWidth, 0.0f, MAX_SPLAT_WIDTH);
 
-		if (ImGui::Button("Render"))
+		chooseRenderAccumulation(numRenderSamples);
+		ImGui::Text("Accumulation: %s, histogram %.0f MB", renderDeepAccumulation ? "deep (fixed32 + 64 bit totals)" :
+			ACCUMULATION_NAMES[renderAccumulationMode], getRenderHistogramMB());
+		if (renderDeepAccumulation || renderAccumulationMode != accumulationMode)
 		{
-			render();
+			ImGui::Text("(replaces %s, which can't hold this render)", ACCUMULATION_NAMES[accumulationMode]);
 		}
 
-		ImGui::End();
-	}
+		//the tent splat adds fractional counts, so it only runs with float accumulation and direct binning
+		bool exactSplat = !renderDeepAccumulation && renderAccumulationMode == ACCUMULATION_FLOAT && !renderDeferredPlotting &&
+			binningMode == BINNING_DIRECT;
+		if (renderSplatWidth > 0.0f && !exactSplat)
+		{
+			ImGui::Text("Splat: jittered, needs float accumulation and direct binning to spread samples");
+		}
 
-	bool init(uint32_t tw, uint32_t th)
-	{
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		IMGUI_SPACER
 
-		if (!shFullScreenTri.init("./shaders/fullScreenTri.vert", "./shaders/ifs.frag")) return false;
-		glGenVertexArrays(1, &vao_fullScreenTri);
+		ImGui::SeparatorText("Extra views");
 
-		for (uint32_t i = 0; i < MAX_VARIATIONS; i++)
+		for (uint32_t i = 0; i < renderViews.size(); i++)
 		{
-			variations[i] = 0;
-			coloursRGB[i * 3 + 0] = 0.0f;
-			coloursRGB[i * 3 + 1] = 0.0f;
-			coloursRGB[i * 3 + 2] = 0.0f;
-			weights[i] = 0.0f;
-		}
+			ImGui::PushID(i);
+			RenderView& view = renderViews[i];
 
-		CLManager::createBuffer<uint32_t>(b_variations, MAX_VARIATIONS, variations);
-		CLManager::createBuffer<float>(b_colours, MAX_VARIATIONS * 3, coloursRGB);
-		CLManager::createBuffer<float>(b_weights, MAX_VARIATIONS, weights);
+			ImGui::SliderFloat2("Centre", &view.centre.x, 0.0f, 1.0f);
+			if (ImGui::InputFloat("Zoom", &view.zoom, 0.5f, 2.0f))
+			{
+				view.zoom = std::max(view.zoom, 0.01f);
+			}
 
-		CLManager::createKernel(k_produceSamples);
-		CLManager::createKernel(k_renderPostProcess);
+			int viewRes[2] = { (int)view.width, (int)view.height };
+			if (ImGui::InputInt2("Resolution", viewRes))
+			{
+				view.width = std::max(viewRes[0], 1);
+				view.height = std::max(viewRes[1], 1);
+			}
 
-		CLManager::setKernelParamBuffer(k_produceSamples, 1, { b_variations, b_colours, b_weights });
-		CLManager::setKernelParamLocal(k_produceSamples, 12, MAX_VARIATIONS * sizeof(uint32_t));
-		CLManager::setKernelParamLocal(k_produceSamples, 13, MAX_VARIATIONS * 3 * sizeof(float));
-		CLManager::setKernelParamLocal(k_produceSamples, 14, MAX_VARIATIONS * sizeof(float));
+			bool removed = ImGui::Button("Remove");
+			ImGui::Separator();
+			ImGui::PopID();
 
-		cam.init(previewTexWidth, previewTexHeight, glm::vec2(0.0f));
+			if (removed)
+			{
+				renderViews.erase(renderViews.begin() + i);
+				break;
+			}
+		}
 
-		setPreviewTexSize(tw, th); //preview texture created here
-		setNumPreviewSamples(10000);
-		setInitialIterations(20);
-		setIterations(5);
-		setGamma(2.2f);
-		setDarkness(2.0f);
+		if (ImGui::Button("Add view"))
+		{
+			renderViews.push_back({ glm::vec2(0.5f), 4.0f, renderTexWidth / 4, renderTexHeight / 4 });
+		}
 
-		numRenderSamples = 1e6;
-		totalPreviewSamples = 0;
-		renderTexWidth = 1920;
-		renderTexHeight = 1080;
-		renderTransparency = false;
-		renderMatchPreviewSampleNum = true;
+		IMGUI_SPACER
 
-		clearEveryFrame = false;
-		clearSingleFrame = false;
-		paused = false;
+		if (ImGui::Button("Render"))
+		{
+			render();
+		}
 
-		addRandomVariation();
-		addRandomVariation();
-		addRandomVariation();
+		IMGUI_SPACER
 
-		return true;
-	}
+		ImGui::SeparatorText("Benchmarks");
 
-	void update()
-	{
-		if (!paused && clearEveryFrame)
+		if (ImGui::Button("Variation selection"))
 		{
-			clearSamples();
+			benchmarkSelection();
 		}
 
-		if (clearSingleFrame)
+		ImGui::SameLine();
+
+		if (ImGui::Button("Plotting"))
 		{
-			clearSamples();
-			clearSingleFrame = false;
+			benchmarkPlotting();
 		}
 
+		ImGui::SameLine();
+
+		if (ImGui::Button("Shared choice"))
+		{
+			compareChoiceModes();
+		}
+
+		ImGui::SameLine();
+
+		if (ImGui::Button("Sampler"))
+		{
+			compareSamplers();
+		}
+
+		ImGui::SameLine();
+
+		if (ImGui::Button("Histogram layout"))
+		{
+			benchmarkHistogramLayouts();
+		}
+
+		ImGui::SameLine();
+
+		if (ImGui::Button("Camera precision"))
+		{
+			benchmarkCameraModes();
+		}
+
+		ImGui::SameLine();
+
+		if (ImGui::Button("Fast maths"))
+		{
+			compareFastVariations();
+		}
+
+		ImGui::SameLine();
+
+		if (ImGui::Button("Affine ceiling"))
+		{
+			benchmarkTransformModes();
+		}
+
+		ImGui::SameLine();
+
+		if (ImGui::Button("Dimensions"))
+		{
+			benchmarkDimensions();
+		}
+
+		ImGui::SameLine();
+
+		if (ImGui::Button("Accumulation formats"))
+		{
+			compareAccumulationFormats();
+		}
+
+		for (const std::string& result : benchmarkResults)
+		{
+			ImGui::Text("%s", result.c_str());
+		}
+
+		ImGui::End();
+	}
+
+	bool init(uint32_t tw, uint32_t th)
+	{
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		if (!shFullScreenTri.init("./shaders/fullScreenTri.vert", "./shaders/ifs.frag")) return false;
+		glGenVertexArrays(1, &vao_fullScreenTri);
+
+		for (uint32_t i = 0; i < MAX_VARIATIONS; i++)
+		{
+			variations[i] = 0;
+			coloursRGB[i * 3 + 0] = 0.0f;
+			coloursRGB[i * 3 + 1] = 0.0f;
+			coloursRGB[i * 3 + 2] = 0.0f;
+			weights[i] = 0.0f;
+			aliasProbabilities[i] = 1.0f;
+			aliasIndices[i] = i;
+		}
+
+		CLManager::createBuffer<uint32_t>(b_variations, MAX_VARIATIONS, variations);
+		CLManager::createBuffer<float>(b_colours, MAX_VARIATIONS * 3, coloursRGB);
+		CLManager::createBuffer<float>(b_weights, MAX_VARIATIONS, weights);
+		CLManager::createBuffer<float>(b_aliasProbabilities, MAX_VARIATIONS, aliasProbabilities);
+		CLManager::createBuffer<uint32_t>(b_aliasIndices, MAX_VARIATIONS, aliasIndices);
+		CLManager::createBuffer<float>(b_affineMaps, MAX_VARIATIONS * AFFINE_MAP_SIZE, affineMaps);
+		CLManager::createBuffer<float>(b_depths, MAX_VARIATIONS, depths);
+		CLManager::createBuffer<uint32_t>(b_blendVariations, MAX_VARIATIONS * MAX_BLEND_VARIATIONS, blendVariations);
+		CLManager::createBuffer<float>(b_blendWeights, MAX_VARIATIONS * MAX_BLEND_VARIATIONS, blendWeights);
+
+		CLManager::createKernel(k_produceSamples);
+		CLManager::createKernel(k_renderPostProcess);
+		CLManager::createKernel(k_countDeferredBuckets);
+		CLManager::createKernel(k_scatterDeferredRecords);
+		CLManager::createKernel(k_reduceDeferredBuckets);
+		CLManager::createKernel(k_flushDeepAccumulation);
+		CLManager::createKernel(k_benchmarkSelection);
+		CLManager::createKernel(k_compareVariations);
+
+		CLManager::setKernelParamBuffer(k_produceSamples, 1, { b_variations, b_colours, b_weights });
+		CLManager::setKernelParamLocal(k_produceSamples, 12, MAX_VARIATIONS * MAX_BLEND_VARIATIONS * sizeof(uint32_t));
+		CLManager::setKernelParamLocal(k_produceSamples, 13, MAX_VARIATIONS * 3 * sizeof(float));
+		CLManager::setKernelParamLocal(k_produceSamples, 14, MAX_VARIATIONS * sizeof(float));
+		CLManager::setKernelParamLocal(k_produceSamples, 19, LOCAL_CACHE_SIZE * sizeof(uint32_t));
+		CLManager::setKernelParamLocal(k_produceSamples, 20, LOCAL_CACHE_SIZE * 8 * sizeof(uint32_t));
+		CLManager::setKernelParamBuffer(k_produceSamples, 21, { b_aliasProbabilities, b_aliasIndices });
+		CLManager::setKernelParamLocal(k_produceSamples, 23, MAX_VARIATIONS * sizeof(float));
+		CLManager::setKernelParamLocal(k_produceSamples, 24, MAX_VARIATIONS * sizeof(uint32_t));
+
+		//deferred records are only written during renders, but the argument always needs a buffer
+		CLManager::createBuffer<uint32_t>(b_deferredRecordsPlaceholder, 2);
+		CLManager::setKernelParamBuffer(k_produceSamples, 26, { b_deferredRecordsPlaceholder });
+
+		CLManager::setKernelParamLocal(k_produceSamples, 28, WORKGROUP_SIZE * 2 * sizeof(float));
+		CLManager::setKernelParamLocal(k_produceSamples, 29, WORKGROUP_SIZE * 3 * sizeof(uint32_t));
+		CLManager::setKernelParamLocal(k_produceSamples, 30, (MAX_VARIATIONS * 2 + 1) * sizeof(uint32_t));
+
+		for (uint32_t i = 0; i < NUM_STATS; i++) previewStatistics[i] = 0;
+		CLManager::createBuffer<uint32_t>(b_statistics, NUM_STATS);
+		CLManager::setKernelParamBuffer(k_produceSamples, 32, { b_statistics });
+		CLManager::setKernelParamLocal(k_produceSamples, 33, NUM_STATS * sizeof(uint32_t));
+
+		//extra views are only plotted during renders, but the arguments always need buffers
+		CLManager::setKernelParamValue(k_produceSamples, 37, 0u);
+		CLManager::createBuffer<float>(b_extraViewMatrices, 16);
+		CLManager::createBuffer<uint32_t>(b_extraViewRects, 4);
+		CLManager::setKernelParamBuffer(k_produceSamples, 38, { b_extraViewMatrices, b_extraViewRects });
+		CLManager::setKernelParamValue(k_produceSamples, 40, 0.0f);
+
+		CLManager::setKernelParamBuffer(k_produceSamples, 45, { b_affineMaps });
+		CLManager::setKernelParamLocal(k_produceSamples, 46, MAX_VARIATIONS * AFFINE_MAP_SIZE * sizeof(float));
+
+		CLManager::setKernelParamBuffer(k_produceSamples, 49, { b_depths });
+		CLManager::setKernelParamLocal(k_produceSamples, 50, MAX_VARIATIONS * sizeof(float));
+
+		CLManager::setKernelParamBuffer(k_produceSamples, 52, { b_blendVariations, b_blendWeights });
+		CLManager::setKernelParamLocal(k_produceSamples, 54, MAX_VARIATIONS * MAX_BLEND_VARIATIONS * sizeof(float));
+
+		cam.init(previewTexWidth, previewTexHeight, glm::vec2(0.0f));
+		cam3D.init((float)previewTexWidth / previewTexHeight, glm::vec3(0.0f, 0.0f, 2.0f));
+		dimensions = DIMENSIONS_2D;
+		fogDensity = 0.5f;
+		CLManager::setKernelParamValue(k_produceSamples, 48, dimensions);
+
+		supportsFixed64 = CLManager::deviceSupportsExtension("cl_khr_int64_base_atomics");
+		accumulationMode = supportsFixed64 ? ACCUMULATION_FIXED64 : ACCUMULATION_FIXED32;
+		CLManager::setKernelParamValue(k_produceSamples, 15, accumulationMode);
+		CLManager::setKernelParamValue(k_renderPostProcess, 6, accumulationMode);
+		histogramLayout = LAYOUT_TILED;
+		supportsFP64 = CLManager::deviceSupportsExtension("cl_khr_fp64");
+		cameraMode = CAMERA_DOUBLE_FLOAT;
+		CLManager::setKernelParamValue(k_produceSamples, 42, cameraMode);
+		CLManager::setKernelParamValue(k_produceSamples, 41, histogramLayout);
+		CLManager::setKernelParamValue(k_renderPostProcess, 10, histogramLayout);
+
+		glUseProgram(shFullScreenTri.getID());
+		glUniform1f(glGetUniformLocation(shFullScreenTri.getID(), "fixedPointScale32"), FIXED_POINT_SCALE_32);
+		glUniform1f(glGetUniformLocation(shFullScreenTri.getID(), "fixedPointScale64"), FIXED_POINT_SCALE_64);
+		glUseProgram(0);
+
+		setPreviewTexSize(tw, th); //preview texture created here
+		setBinningMode(BINNING_LOCAL_CACHE);
+		setSelectionMode(SELECTION_ALIAS);
+		setExecutionMode(EXECUTION_DIRECT);
+		setChoiceMode(CHOICE_INDEPENDENT);
+		setSamplerMode(SAMPLER_LOW_DISCREPANCY);
+		setTransformMode(TRANSFORM_VARIATIONS);
+		setNumPreviewSamples(10000);
+		setInitialIterations(20);
+		setIterations(5);
+		setSymmetry(1, false);
+		setCountStatistics(false);
+		setGamma(2.2f);
+		setDarkness(2.0f);
+
+		numRenderSamples = 1e6;
+		totalPreviewSamples = 0;
+		renderTexWidth = 1920;
+		renderTexHeight = 1080;
+		renderTransparency = false;
+		renderDeferredPlotting = false;
+		renderSplatWidth = 0.0f;
+		renderMatchPreviewSampleNum = true;
+
+		clearEveryFrame = false;
+		clearSingleFrame = false;
+		resetPointStates = true;
+		useSpecialisedKernels = true;
+		useFastVariations = false;
+		activeProgramKey = "";
+		paused = false;
+
+		addRandomVariation();
+		addRandomVariation();
+		addRandomVariation();
+
+		return true;
+	}
+
+	void update()
+	{
+		if (!paused && clearEveryFrame)
+		{
+			clearSamples();
+		}
+
+		if (clearSingleFrame)
+		{
+			clearSamples();
+			clearSingleFrame = false;
+		}
+
+		updateKernelSpecialisation();
+
 		if (!paused && numVariations > 0)
 		{
 			acquireGLObjects();
 
 			CLManager::setKernelParamValue(k_produceSamples, 10, frameNum);
+			CLManager::setKernelParamValue(k_produceSamples, 17, resetPointStates);
 			CLManager::runKernel(k_produceSamples);
+			resetPointStates = false;
+
+			//reading the counts waits for the frame to finish, so only do it when they're shown
+			if (countStatistics) readStatistics(previewStatistics);
 			
 			releaseGLObjects();
 		}
@@ -623,10 +1745,80 @@ namespace ifs
 		}
 	}
 
+	void updateKernelSpecialisation()
+	{
+		//collect a finished background compile
+		if (compilingProgram.valid() && compilingProgram.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			specialisedPrograms[compilingProgramKey] = compilingProgram.get();
+			if (!specialisedPrograms[compilingProgramKey].success)
+			{
+				std::cout << "failed to compile specialised kernel for variations" << compilingProgramKey << ", using generic kernel" << std::endl;
+			}
+		}
+
+		//slots with no weight are left out of the specialised blends, so they take no time
+		std::vector<std::vector<uint32_t>> programBlends;
+		if (useSpecialisedKernels)
+		{
+			for (uint32_t i = 0; i < numVariations; i++)
+			{
+				std::vector<uint32_t> blend(MAX_BLEND_VARIATIONS, UNUSED_BLEND_SLOT);
+				for (uint32_t b = 0; b < MAX_BLEND_VARIATIONS; b++)
+				{
+					if (blendWeights[i * MAX_BLEND_VARIATIONS + b] == 0.0f) continue;
+					blend[b] = b == 0 ? variations[i] : blendVariations[i * MAX_BLEND_VARIATIONS + b];
+				}
+				programBlends.push_back(blend);
+			}
+		}
+		std::string key = getProgramKey(programBlends, useFastVariations);
+
+		//use the specialised kernel once it has compiled, and the generic one until then
+		auto cached = specialisedPrograms.find(key);
+		bool ready = cached != specialisedPrograms.end() && cached->second.success;
+		std::string programKey = ready ? key : "";
+		if (programKey != activeProgramKey)
+		{
+			CLManager::setKernelProgram(k_produceSamples, ready ? cached->second.program : CLManager::program);
+			activeProgramKey = programKey;
+		}
+
+		//only one compile at a time, so quickly changing variations doesn't queue up lots of work
+		if (!key.empty() && cached == specialisedPrograms.end() && !compilingProgram.valid())
+		{
+			bool fastVariations = useFastVariations;
+			compilingProgramKey = key;
+			compilingProgram = std::async(std::launch::async, [programBlends, fastVariations]()
+			{
+				SpecialisedProgram sp;
+				sp.success = CLManager::buildProgram(createKernelSource(programBlends, fastVariations), sp.program);
+				return sp;
+			});
+		}
+	}
+
+	std::string getProgramKey(const std::vector<std::vector<uint32_t>>& blends, bool fastVariations)
+	{
+		//key of the program createKernelSource builds from these arguments. a "fast" prefix for fast maths, then each
+		//entry's used slots as [slot]variation. the generic precise program is the empty key, which is CLManager::program
+		std::string key = fastVariations ? "fast" : "";
+		for (const std::vector<uint32_t>& blend : blends)
+		{
+			key += "_";
+			for (uint32_t b = 0; b < blend.size(); b++)
+			{
+				if (blend[b] != UNUSED_BLEND_SLOT) key += "[" + std::to_string(b) + "]" + std::to_string(blend[b]);
+			}
+		}
+
+		return key;
+	}
+
 	void clearSamples()
 	{
 		//clear the preview buffer and start from 0 samples
-		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_RGBA32F, GL_RGBA, GL_FLOAT, NULL);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
 		totalPreviewSamples = 0;
 		if (renderMatchPreviewSampleNum) numRenderSamples = totalPreviewSamples;
 	}
@@ -662,30 +1854,59 @@ namespace ifs
 		std::cout << "Rendering..." << std::endl;
 
 		uint32_t numPixels = renderTexWidth * renderTexHeight;
-		CLManager::createBuffer<float>(b_renderTexture, numPixels * 4);
+		for (const RenderView& view : renderViews)
+		{
+			numPixels += view.width * view.height;
+		}
+
+		createRenderHistogram(numRenderSamples, true);
 		CLManager::createBuffer<uint8_t>(b_processedRenderTexture, numPixels * 4);
-		
 
-		//produce the samples on the texture
-		CLManager::setKernelRange(k_produceSamples, numRenderSamples);
-		CLManager::setKernelParamBuffer(k_produceSamples, 0, { b_renderTexture });
-		cam.setAspectRatio(renderTexWidth, renderTexHeight);
-		CLManager::setKernelParamValue(k_produceSamples, 7, cam.getMatViewCL());
-		CLManager::setKernelParamValue(k_produceSamples, 8, renderTexWidth);
-		CLManager::setKernelParamValue(k_produceSamples, 9, renderTexHeight);
-		CLManager::setKernelParamValue(k_produceSamples, 11, numRenderSamples);
-		CLManager::runKernel(k_produceSamples);
+		produceRenderSamples(numRenderSamples, renderDeferredPlotting ? BINNING_DEFERRED : binningMode, 0, true);
+		std::cout << "Respawned points: " << renderStatistics[STAT_RESPAWNS] << std::endl;
+		std::cout << "Merged plot hits: " << renderStatistics[STAT_MERGED_HITS] << std::endl;
+		if (countStatistics)
+		{
+			uint64_t renderPlots = (uint64_t)numRenderSamples * std::max(iterations, 1u) * symmetryOrder * (symmetryMirror ? 2 : 1) *
+				(renderViews.size() + 1);
+			std::cout << "Off-screen plots: " << renderStatistics[STAT_OFF_SCREEN] << " of " << renderPlots << std::endl;
+			std::cout << "Non-finite points: " << renderStatistics[STAT_NON_FINITE] << std::endl;
+			for (uint32_t i = 0; i < numVariations; i++)
+			{
+				std::cout << "Variation " << i << " (" << variations[i] << ") chosen: " << renderStatistics[STAT_SELECTIONS + i]
+					<< std::endl;
+			}
+		}
 
 		std::cout << "Applying post process..." << std::endl;
 
 		//apply brightness and gamma and convert from float to byte
-		CLManager::setKernelRange(k_renderPostProcess, numPixels);
 		CLManager::setKernelParamBuffer(k_renderPostProcess, 0, { b_renderTexture, b_processedRenderTexture });
 		CLManager::setKernelParamValue(k_renderPostProcess, 2, gamma);
 		CLManager::setKernelParamValue(k_renderPostProcess, 3, 1.0f / darkness);
 		CLManager::setKernelParamValue(k_renderPostProcess, 4, renderTransparency);
-		CLManager::setKernelParamValue(k_renderPostProcess, 5, numPixels);
-		CLManager::runKernel(k_renderPostProcess);
+		CLManager::setKernelParamValue(k_renderPostProcess, 6, renderDeepAccumulation ? ACCUMULATION_FIXED64 : renderAccumulationMode);
+		CLManager::setKernelParamBuffer(k_renderPostProcess, 11, { b_colours });
+		CLManager::setKernelParamValue(k_renderPostProcess, 12, numVariations);
+
+		//once for the main image and each extra view, as they each take up a different amount of the histogram
+		uint32_t histogramOffset = 0;
+		uint32_t outputOffset = 0;
+		for (uint32_t v = 0; v <= renderViews.size(); v++)
+		{
+			uint32_t width = v == 0 ? renderTexWidth : renderViews[v - 1].width;
+			uint32_t height = v == 0 ? renderTexHeight : renderViews[v - 1].height;
+
+			CLManager::setKernelRange(k_renderPostProcess, width * height);
+			CLManager::setKernelParamValue(k_renderPostProcess, 5, width * height);
+			CLManager::setKernelParamValue(k_renderPostProcess, 7, width);
+			CLManager::setKernelParamValue(k_renderPostProcess, 8, histogramOffset);
+			CLManager::setKernelParamValue(k_renderPostProcess, 9, outputOffset);
+			CLManager::runKernel(k_renderPostProcess);
+
+			histogramOffset += getHistogramPixelCount(width, height);
+			outputOffset += width * height;
+		}
 
 		std::cout << "Saving to " << renderOutputPath << std::endl;
 
@@ -695,23 +1916,868 @@ namespace ifs
 		stbi_write_png_compression_level = 1;
 		stbi_flip_vertically_on_write(1);
 		stbi_write_png(renderOutputPath.c_str(), renderTexWidth, renderTexHeight, 4, texture, renderTexWidth * 4 * sizeof(uint8_t));
+
+		//extra views follow the main image in the texture, and are saved next to it
+		std::string pathStem = renderOutputPath;
+		if (pathStem.size() > 4 && pathStem.substr(pathStem.size() - 4) == ".png") pathStem.resize(pathStem.size() - 4);
+		uint32_t pixelOffset = renderTexWidth * renderTexHeight;
+		for (uint32_t v = 0; v < renderViews.size(); v++)
+		{
+			const RenderView& view = renderViews[v];
+			std::string viewPath = pathStem + "_view" + std::to_string(v + 1) + ".png";
+			std::cout << "Saving to " << viewPath << std::endl;
+			stbi_write_png(viewPath.c_str(), view.width, view.height, 4, texture + pixelOffset * 4, view.width * 4 * sizeof(uint8_t));
+			pixelOffset += view.width * view.height;
+		}
 		delete[] texture;
 
 		std::cout << "Render complete" << std::endl;
 
-		//put preview kernel parameters back
-		CLManager::setKernelRange(k_produceSamples, numPreviewSamples);
+		setPreviewKernelParams();
+	}
+
+	void chooseRenderAccumulation(uint32_t numSamples)
+	{
+		//use the preview's accumulation mode unless the busiest pixel of the render could get more samples than 32 bits
+		//count exactly. that is estimated from the mean hits per pixel of the view with the fewest pixels, as the samples
+		//are spread over every view
+		uint64_t plotsPerView = (uint64_t)numSamples * std::max(iterations, 1u) * symmetryOrder * (symmetryMirror ? 2 : 1);
+		uint64_t viewPixels = (uint64_t)renderTexWidth * renderTexHeight;
+		for (const RenderView& view : renderViews)
+		{
+			viewPixels = std::min(viewPixels, (uint64_t)view.width * view.height);
+		}
+
+		uint64_t peakHits = std::min(plotsPerView, plotsPerView * PEAK_HITS_FACTOR / std::max(viewPixels, (uint64_t)1));
+		bool exceeds32Bit = peakHits >= EXACT_32_BIT_HITS;
+		renderAccumulationMode = accumulationMode;
+		renderDeepAccumulation = false;
+
+		//per-entry colour is only there to recolour the preview, so renders which it can't count or which go past its memory
+		//cap use fixed point colour
+		if (accumulationMode == ACCUMULATION_ENTRY_CHANNELS && (exceeds32Bit ||
+			getEntryChannelMB(getNumRenderPixels()) * getHistogramPixelSize(accumulationMode) > MAX_ENTRY_CHANNEL_MB))
+		{
+			renderAccumulationMode = ACCUMULATION_FIXED32;
+		}
+
+		if (renderAccumulationMode != ACCUMULATION_FIXED64 && exceeds32Bit)
+		{
+			renderAccumulationMode = supportsFixed64 ? ACCUMULATION_FIXED64 : ACCUMULATION_FIXED32;
+			renderDeepAccumulation = !supportsFixed64;
+		}
+	}
+
+	float getRenderHistogramMB()
+	{
+		//memory used by the render's histogram, including the per launch histogram for deep accumulation
+		uint32_t pixelSize = renderDeepAccumulation ? 8 + 4 : getHistogramPixelSize(renderAccumulationMode);
+		return (float)getNumRenderPixels() * pixelSize * sizeof(uint32_t) / (float)(1 << 20);
+	}
+
+	void createRenderHistogram(uint32_t numSamples, bool logMemory)
+	{
+		//choose the accumulation mode for a render of numSamples and create b_renderTexture for it. produceRenderSamples
+		//then needs to be given the same number of samples
+		chooseRenderAccumulation(numSamples);
+		uint32_t pixelSize = renderDeepAccumulation ? 8 : getHistogramPixelSize(renderAccumulationMode);
+		CLManager::createBuffer<uint32_t>(b_renderTexture, getNumRenderPixels() * pixelSize);
+
+		if (logMemory)
+		{
+			std::cout << "Accumulating with " << (renderDeepAccumulation ? "fixed32 launches added to 64 bit totals" :
+				ACCUMULATION_NAMES[renderAccumulationMode]) << ", histogram " << getRenderHistogramMB() << " MB" << std::endl;
+			if (renderDeepAccumulation || renderAccumulationMode != accumulationMode)
+			{
+				std::cout << "  instead of " << ACCUMULATION_NAMES[accumulationMode] << ", which can't hold this render"
+					<< std::endl;
+			}
+		}
+	}
+
+	void readStatistics(uint32_t* dest)
+	{
+		//take the counts from the last launch of produceSamples, and reset them for the next one
+		CLManager::readBuffer(b_statistics, NUM_STATS, dest);
+		CLManager::fillBuffer<uint32_t>(b_statistics, NUM_STATS, 0);
+	}
+
+	void produceRenderSamples(uint32_t numSamples, uint32_t renderBinningMode, uint32_t firstFrame, bool logProgress)
+	{
+		//produce the samples on b_renderTexture, in chunks which keep iterating the same sample points. the preview kernel
+		//parameters need putting back afterwards with setPreviewKernelParams. each chunk counts as one frame starting from
+		//firstFrame, which sets the random start points and the shared choice stream
+
+		//per-entry colour always plots straight to the histogram. packed rgb is summed per pixel by deferred plotting, so
+		//each pixel's sum is only rounded once per chunk
+		if (renderAccumulationMode == ACCUMULATION_ENTRY_CHANNELS) renderBinningMode = BINNING_DIRECT;
+		if (renderAccumulationMode == ACCUMULATION_PACKED_RGB) renderBinningMode = BINNING_DEFERRED;
+
+		//deferred plotting stores a record for every iteration of a chunk, so chunks are limited to fit the record buffers
+		uint32_t plotsPerView = std::max(iterations, 1u) * symmetryOrder * (symmetryMirror ? 2 : 1);
+		uint32_t recordsPerSample = plotsPerView * ((uint32_t)renderViews.size() + 1);
+		uint32_t maxChunkSize = renderBinningMode == BINNING_DEFERRED ? std::max(maxDeferredRecords / recordsPerSample, 1u) : renderChunkSize;
+
+		//deep accumulation keeps each chunk's histogram under the 32 bit limit, see createRenderHistogram
+		if (renderDeepAccumulation) maxChunkSize = std::min(maxChunkSize, std::max(DEEP_CHUNK_PLOTS / plotsPerView, 1u));
+		uint32_t chunkSize = std::max(std::min(numSamples, maxChunkSize), 1u);
+		CLManager::createBuffer<float>(b_renderPointStates, chunkSize * POINT_STATE_SIZE);
+
+		uint32_t numPixels = getNumRenderPixels();
+		uint32_t numBuckets = (numPixels + DEFERRED_BUCKET_PIXELS - 1) / DEFERRED_BUCKET_PIXELS;
+
+		//where produceSamples accumulates
+		std::string histogram = b_renderTexture;
+		if (renderDeepAccumulation)
+		{
+			histogram = b_renderChunkTexture;
+			CLManager::createBuffer<uint32_t>(b_renderChunkTexture, numPixels * 4);
+			CLManager::setKernelParamBuffer(k_flushDeepAccumulation, 0, { b_renderChunkTexture, b_renderTexture });
+			CLManager::setKernelParamValue(k_flushDeepAccumulation, 2, numPixels * 4);
+			CLManager::setKernelRange(k_flushDeepAccumulation, numPixels * 4);
+		}
+
+		std::vector<uint32_t> bucketOffsets;
+		if (renderBinningMode == BINNING_DEFERRED)
+		{
+			CLManager::createBuffer<uint32_t>(b_deferredRecords, chunkSize * recordsPerSample * 2);
+			CLManager::createBuffer<uint32_t>(b_sortedDeferredRecords, chunkSize * recordsPerSample * 2);
+			CLManager::createBuffer<uint32_t>(b_bucketCounts, numBuckets);
+			CLManager::createBuffer<uint32_t>(b_bucketOffsets, numBuckets + 1);
+			CLManager::createBuffer<uint32_t>(b_bucketCursors, numBuckets);
+			bucketOffsets.resize(numBuckets + 1);
+
+			CLManager::setKernelParamBuffer(k_produceSamples, 26, { b_deferredRecords });
+			CLManager::setKernelParamBuffer(k_countDeferredBuckets, 0, { b_deferredRecords, b_bucketCounts });
+			CLManager::setKernelParamBuffer(k_scatterDeferredRecords, 0, { b_deferredRecords, b_sortedDeferredRecords, b_bucketCursors });
+			CLManager::setKernelParamBuffer(k_reduceDeferredBuckets, 0, { histogram, b_sortedDeferredRecords, b_bucketOffsets });
+			CLManager::setKernelParamValue(k_reduceDeferredBuckets, 3, numPixels);
+			CLManager::setKernelParamValue(k_reduceDeferredBuckets, 4, renderAccumulationMode);
+			CLManager::setKernelParamLocal(k_reduceDeferredBuckets, 5, DEFERRED_BUCKET_PIXELS * 8 * sizeof(uint32_t));
+			CLManager::setKernelRange(k_reduceDeferredBuckets, numBuckets * WORKGROUP_SIZE); //one work group per bucket
+		}
+
+		CLManager::setKernelParamBuffer(k_produceSamples, 0, { histogram });
+		CLManager::setKernelParamBuffer(k_produceSamples, 16, { b_renderPointStates });
+		CLManager::setKernelParamValue(k_produceSamples, 15, renderAccumulationMode);
+		cam.setAspectRatio(renderTexWidth, renderTexHeight);
+		cam3D.setAspectRatio(renderTexWidth, renderTexHeight);
+		setCameraKernelParams();
+		CLManager::setKernelParamValue(k_produceSamples, 8, renderTexWidth);
+		CLManager::setKernelParamValue(k_produceSamples, 9, renderTexHeight);
+		CLManager::setKernelParamValue(k_produceSamples, 18, renderBinningMode);
+		CLManager::setKernelParamValue(k_produceSamples, 40, glm::clamp(renderSplatWidth, 0.0f, MAX_SPLAT_WIDTH));
+		setRenderViewParams();
+
+		for (uint32_t j = 0; j < NUM_STATS; j++) renderStatistics[j] = 0;
+		CLManager::fillBuffer<uint32_t>(b_statistics, NUM_STATS, 0); //may hold counts from preview frames which weren't read
+
+		if (logProgress) std::cout << "Buffer memory in use: " << CLManager::getTotalBufferMemUsageMB() << " MB" << std::endl;
+
+		uint32_t numChunks = (numSamples + chunkSize - 1) / chunkSize;
+		for (uint32_t chunk = 0; chunk < numChunks; chunk++)
+		{
+			uint32_t n = std::min(chunkSize, numSamples - chunk * chunkSize);
+			CLManager::setKernelRange(k_produceSamples, getNumWorkItems(n));
+			CLManager::setKernelParamValue(k_produceSamples, 10, firstFrame + chunk); //fixed seeds so renders are repeatable
+			CLManager::setKernelParamValue(k_produceSamples, 11, n);
+			CLManager::setKernelParamValue(k_produceSamples, 17, chunk == 0);
+			CLManager::runKernel(k_produceSamples);
+
+			uint32_t chunkStatistics[NUM_STATS];
+			readStatistics(chunkStatistics);
+			for (uint32_t j = 0; j < NUM_STATS; j++) renderStatistics[j] += chunkStatistics[j];
+
+			if (renderBinningMode == BINNING_DEFERRED)
+			{
+				//bucket sort the chunk's records by pixel, then sum each bucket into the histogram
+				uint32_t numRecords = n * recordsPerSample;
+				CLManager::fillBuffer<uint32_t>(b_bucketCounts, numBuckets, 0);
+				CLManager::setKernelRange(k_countDeferredBuckets, numRecords);
+				CLManager::setKernelParamValue(k_countDeferredBuckets, 2, numRecords);
+				CLManager::runKernel(k_countDeferredBuckets);
+
+				//only one count per bucket, so the prefix sum is cheap enough to do here
+				CLManager::readBuffer(b_bucketCounts, numBuckets, bucketOffsets.data() + 1);
+				bucketOffsets[0] = 0;
+				for (uint32_t b = 0; b < numBuckets; b++)
+				{
+					bucketOffsets[b + 1] += bucketOffsets[b];
+				}
+				CLManager::writeBuffer(b_bucketOffsets, numBuckets + 1, bucketOffsets.data());
+				CLManager::writeBuffer(b_bucketCursors, numBuckets, bucketOffsets.data());
+
+				CLManager::setKernelRange(k_scatterDeferredRecords, numRecords);
+				CLManager::setKernelParamValue(k_scatterDeferredRecords, 3, numRecords);
+				CLManager::runKernel(k_scatterDeferredRecords);
+				CLManager::runKernel(k_reduceDeferredBuckets);
+			}
+
+			if (renderDeepAccumulation)
+			{
+				CLManager::runKernel(k_flushDeepAccumulation);
+			}
+
+			if (logProgress && numChunks > 1) std::cout << "  chunk " << chunk + 1 << "/" << numChunks << std::endl;
+		}
+
+		CLManager::deleteBuffer(b_renderPointStates);
+		if (renderDeepAccumulation) CLManager::deleteBuffer(b_renderChunkTexture);
+		if (renderBinningMode == BINNING_DEFERRED)
+		{
+			CLManager::deleteBuffer(b_deferredRecords);
+			CLManager::deleteBuffer(b_sortedDeferredRecords);
+			CLManager::deleteBuffer(b_bucketCounts);
+			CLManager::deleteBuffer(b_bucketOffsets);
+			CLManager::deleteBuffer(b_bucketCursors);
+		}
+	}
+
+	uint32_t getNumRenderPixels()
+	{
+		//pixels in the render histogram, with each extra view stored after the main image
+		uint32_t numPixels = getHistogramPixelCount(renderTexWidth, renderTexHeight);
+		for (const RenderView& view : renderViews)
+		{
+			numPixels += getHistogramPixelCount(view.width, view.height);
+		}
+
+		return numPixels;
+	}
+
+	void setRenderViewParams()
+	{
+		//give produceSamples the extra views, framed from the render camera, which needs its aspect ratio set first
+		uint32_t numExtraViews = renderViews.size();
+		CLManager::setKernelParamValue(k_produceSamples, 37, numExtraViews);
+		if (numExtraViews == 0) return;
+
+		std::vector<float> matrices(numExtraViews * 16);
+		std::vector<uint32_t> rects(numExtraViews * 4);
+		uint32_t pixelOffset = getHistogramPixelCount(renderTexWidth, renderTexHeight);
+		for (uint32_t v = 0; v < numExtraViews; v++)
+		{
+			const RenderView& view = renderViews[v];
+
+			Camera2D viewCam;
+			viewCam.position = cam.position + glm::dvec2((view.centre * 2.0f - 1.0f) * cam.view);
+			viewCam.zoom = cam.zoom * view.zoom;
+			viewCam.setAspectRatio(view.width, view.height);
+
+			mat4wrap m = cameraMode == CAMERA_SINGLE ? viewCam.getMatViewCL() : viewCam.getMatViewRelativeCL(cam.position);
+			if (dimensions == DIMENSIONS_3D)
+			{
+				//crop the 3d camera's clip space to the view's part of the main image, the same part the 2d view takes
+				glm::vec2 halfSize = glm::vec2(viewCam.ar / cam3D.ar, 1.0f) / view.zoom;
+				glm::vec2 offset = view.centre * 2.0f - 1.0f;
+				glm::mat4 crop(1.0f);
+				crop[0][0] = 1.0f / halfSize.x;
+				crop[1][1] = 1.0f / halfSize.y;
+				crop[3][0] = -offset.x / halfSize.x;
+				crop[3][1] = -offset.y / halfSize.y;
+				m = toCL(crop * cam3D.getMatrixWorldToScreen());
+			}
+			std::copy(m.s, m.s + 16, &matrices[v * 16]);
+			rects[v * 4 + 0] = view.width;
+			rects[v * 4 + 1] = view.height;
+			rects[v * 4 + 2] = pixelOffset;
+			rects[v * 4 + 3] = 0;
+			pixelOffset += getHistogramPixelCount(view.width, view.height);
+		}
+
+		CLManager::createBuffer<float>(b_extraViewMatrices, numExtraViews * 16, matrices.data());
+		CLManager::createBuffer<uint32_t>(b_extraViewRects, numExtraViews * 4, rects.data());
+		CLManager::setKernelParamBuffer(k_produceSamples, 38, { b_extraViewMatrices, b_extraViewRects });
+	}
+
+	void setPreviewKernelParams()
+	{
+		//put preview kernel parameters back after a render
+		CLManager::setKernelRange(k_produceSamples, getNumWorkItems(numPreviewSamples));
 		CLManager::setKernelParamGLBuffer(k_produceSamples, 0, { glb_previewTexture });
+		CLManager::setKernelParamBuffer(k_produceSamples, 16, { b_pointStates });
+		CLManager::setKernelParamBuffer(k_produceSamples, 26, { b_deferredRecordsPlaceholder });
 		cam.setAspectRatio(previewTexWidth, previewTexHeight);
-		CLManager::setKernelParamValue(k_produceSamples, 7, cam.getMatViewCL());
+		cam3D.setAspectRatio(previewTexWidth, previewTexHeight);
+		setCameraKernelParams();
 		CLManager::setKernelParamValue(k_produceSamples, 8, previewTexWidth);
 		CLManager::setKernelParamValue(k_produceSamples, 9, previewTexHeight);
 		CLManager::setKernelParamValue(k_produceSamples, 11, numPreviewSamples);
+		CLManager::setKernelParamValue(k_produceSamples, 15, accumulationMode);
+		setPreviewBinningParam();
+		CLManager::setKernelParamValue(k_produceSamples, 31, choiceMode);
+		CLManager::setKernelParamValue(k_produceSamples, 34, samplerMode);
+		CLManager::setKernelParamValue(k_produceSamples, 37, 0u);
+		CLManager::setKernelParamValue(k_produceSamples, 40, 0.0f);
 	}
 
-	void destroy()
+	bool startRenderBenchmark(const char* name)
+	{
+		//print what is being benchmarked with the render settings and clear the previous results. false when there is
+		//nothing to render
+		if (numRenderSamples == 0 || numVariations == 0) return false;
+
+		std::cout << "Benchmarking " << name << " with " << numRenderSamples << " samples at " << renderTexWidth << "x"
+			<< renderTexHeight << "..." << std::endl;
+		benchmarkResults.clear();
+		return true;
+	}
+
+	float timeRender(const char* name, uint32_t renderBinningMode)
+	{
+		//time producing a render's samples with the current kernel parameters, without saving an image, and add the time
+		//and iteration rate to the benchmark results. returns the time in ms
+		createRenderHistogram(numRenderSamples, false);
+
+		auto start = std::chrono::steady_clock::now();
+		produceRenderSamples(numRenderSamples, renderBinningMode, 0, false);
+		auto end = std::chrono::steady_clock::now();
+
+		CLManager::deleteBuffer(b_renderTexture);
+
+		float ms = std::chrono::duration<float, std::milli>(end - start).count();
+		char result[128];
+		int length = snprintf(result, sizeof(result), "%s: %.1f ms (%.1f M iterations/s", name, ms,
+			(float)numRenderSamples * std::max(iterations, 1u) / ms / 1000.0f);
+		if (renderStatistics[STAT_MERGED_HITS] > 0)
+		{
+			length += snprintf(result + length, sizeof(result) - length, ", %llu merged hits",
+				(unsigned long long)renderStatistics[STAT_MERGED_HITS]);
+		}
+		snprintf(result + length, sizeof(result) - length, ")");
+
+		benchmarkResults.push_back(result);
+		std::cout << "  " << result << std::endl;
+		return ms;
+	}
+
+	void benchmarkPlotting()
+	{
+		//time each way of getting the render's samples into the histogram
+		if (!startRenderBenchmark("plotting")) return;
+
+		const char* names[] = { "direct", "local cache", "deferred" };
+		for (uint32_t mode = BINNING_DIRECT; mode <= BINNING_DEFERRED; mode++)
+		{
+			timeRender(names[mode], mode);
+		}
+
+		setPreviewKernelParams();
+	}
+
+	void benchmarkHistogramLayouts()
+	{
+		//time the render with each histogram layout at a few common resolutions. cache hit rates can't be read through
+		//opencl, so use the vendor's profiler alongside this for those
+		if (numRenderSamples == 0 || numVariations == 0) return;
+
+		const uint32_t resolutions[][2] = { { 1920, 1080 }, { 3840, 2160 }, { 7680, 4320 } };
+		const char* names[] = { "linear", "tiled" };
+		uint32_t savedWidth = renderTexWidth;
+		uint32_t savedHeight = renderTexHeight;
+		uint32_t savedLayout = histogramLayout;
+
+		std::cout << "Benchmarking histogram layouts with " << numRenderSamples << " samples..." << std::endl;
+		benchmarkResults.clear();
+
+		for (const auto& resolution : resolutions)
+		{
+			renderTexWidth = resolution[0];
+			renderTexHeight = resolution[1];
+
+			for (uint32_t layout = LAYOUT_LINEAR; layout <= LAYOUT_TILED; layout++)
+			{
+				histogramLayout = layout;
+				CLManager::setKernelParamValue(k_produceSamples, 41, histogramLayout);
+
+				char name[64];
+				snprintf(name, sizeof(name), "%ux%u %s", renderTexWidth, renderTexHeight, names[layout]);
+				timeRender(name, binningMode);
+			}
+		}
+
+		renderTexWidth = savedWidth;
+		renderTexHeight = savedHeight;
+		histogramLayout = savedLayout;
+		CLManager::setKernelParamValue(k_produceSamples, 41, histogramLayout);
+		setPreviewKernelParams();
+	}
+
+	void benchmarkCameraModes()
+	{
+		//time the render with each camera precision mode
+		if (!startRenderBenchmark("camera precision")) return;
+
+		const char* names[] = { "single", "double-float", "fp64" };
+		uint32_t savedMode = cameraMode;
+		for (uint32_t mode = CAMERA_SINGLE; mode <= CAMERA_FP64; mode++)
+		{
+			if (mode == CAMERA_FP64 && !supportsFP64) continue;
+
+			cameraMode = mode;
+			CLManager::setKernelParamValue(k_produceSamples, 42, cameraMode);
+			timeRender(names[mode], binningMode);
+		}
+
+		if (!supportsFP64) benchmarkResults.push_back("fp64: not supported on this device");
+
+		cameraMode = savedMode;
+		CLManager::setKernelParamValue(k_produceSamples, 42, cameraMode);
+		setPreviewKernelParams();
+	}
+
+	void benchmarkSelection()
+	{
+		//time variation selection on its own with random weights, for each selection mode at a few numbers of variations
+		const uint32_t numItems = 1 << 20;
+		const uint32_t benchmarkIterations = 256;
+		const uint32_t repeats = 5;
+		const uint32_t variationCounts[] = { 3, 8, 16 };
+
+		std::string b_benchmarkResults = "benchmarkResults";
+		std::string b_benchmarkWeights = "benchmarkWeights";
+		std::string b_benchmarkAliasProbabilities = "benchmarkAliasProbabilities";
+		std::string b_benchmarkAliasIndices = "benchmarkAliasIndices";
+
+		CLManager::createBuffer<uint32_t>(b_benchmarkResults, numItems);
+		CLManager::createBuffer<float>(b_benchmarkWeights, MAX_VARIATIONS);
+		CLManager::createBuffer<float>(b_benchmarkAliasProbabilities, MAX_VARIATIONS);
+		CLManager::createBuffer<uint32_t>(b_benchmarkAliasIndices, MAX_VARIATIONS);
+
+		CLManager::setKernelRange(k_benchmarkSelection, numItems);
+		CLManager::setKernelParamBuffer(k_benchmarkSelection, 0, { b_benchmarkResults, b_benchmarkWeights,
+			b_benchmarkAliasProbabilities, b_benchmarkAliasIndices });
+		CLManager::setKernelParamValue(k_benchmarkSelection, 5, benchmarkIterations);
+		CLManager::setKernelParamValue(k_benchmarkSelection, 7, numItems);
+		CLManager::setKernelParamLocal(k_benchmarkSelection, 8, MAX_VARIATIONS * sizeof(float));
+		CLManager::setKernelParamLocal(k_benchmarkSelection, 9, MAX_VARIATIONS * sizeof(float));
+		CLManager::setKernelParamLocal(k_benchmarkSelection, 10, MAX_VARIATIONS * sizeof(uint32_t));
+
+		std::cout << "Benchmarking variation selection..." << std::endl;
+		benchmarkResults.clear();
+
+		for (uint32_t n : variationCounts)
+		{
+			float w[MAX_VARIATIONS];
+			float probabilities[MAX_VARIATIONS];
+			uint32_t aliases[MAX_VARIATIONS];
+			for (uint32_t i = 0; i < n; i++) w[i] = randomFloat();
+			buildAliasTable(w, n, probabilities, aliases);
+
+			CLManager::writeBuffer(b_benchmarkWeights, n, w);
+			CLManager::writeBuffer(b_benchmarkAliasProbabilities, n, probabilities);
+			CLManager::writeBuffer(b_benchmarkAliasIndices, n, aliases);
+			CLManager::setKernelParamValue(k_benchmarkSelection, 4, n);
+
+			float nsPerIteration[2];
+			for (uint32_t mode = SELECTION_LINEAR; mode <= SELECTION_ALIAS; mode++)
+			{
+				CLManager::setKernelParamValue(k_benchmarkSelection, 6, mode);
+				CLManager::runKernelTimed(k_benchmarkSelection); //warm up
+
+				float ms = 0.0f;
+				for (uint32_t r = 0; r < repeats; r++)
+				{
+					ms += CLManager::runKernelTimed(k_benchmarkSelection);
+				}
+
+				nsPerIteration[mode] = ms * 1e6f / repeats / ((float)numItems * benchmarkIterations);
+			}
+
+			char result[128];
+			snprintf(result, sizeof(result), "%2u variations: linear %.4f ns, alias %.4f ns per iteration (%.1f%% saved)", n,
+				nsPerIteration[SELECTION_LINEAR], nsPerIteration[SELECTION_ALIAS],
+				100.0f * (1.0f - nsPerIteration[SELECTION_ALIAS] / nsPerIteration[SELECTION_LINEAR]));
+			benchmarkResults.push_back(result);
+			std::cout << "  " << result << std::endl;
+		}
+
+		CLManager::deleteBuffer(b_benchmarkResults);
+		CLManager::deleteBuffer(b_benchmarkWeights);
+		CLManager::deleteBuffer(b_benchmarkAliasProbabilities);
+		CLManager::deleteBuffer(b_benchmarkAliasIndices);
+	}
+
+	void unpackRGB9E5(uint32_t v, float* rgb)
 	{
+		//host copy of the kernels' unpackRGB9E5
+		int exponent = v & 31;
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			uint32_t mantissa = (v >> (23 - c * PACKED_MANTISSA_BITS)) & ((1u << PACKED_MANTISSA_BITS) - 1);
+			rgb[c] = std::ldexp((float)mantissa, exponent - PACKED_EXPONENT_BIAS - PACKED_MANTISSA_BITS);
+		}
+	}
 
+	void paletteColour(float t, float* rgb)
+	{
+		//host copy of the kernels' paletteColour, using the current entry colours
+		if (numVariations < 2)
+		{
+			for (uint32_t c = 0; c < 3; c++) rgb[c] = coloursRGB[c];
+			return;
+		}
+
+		float x = std::min(std::max(t, 0.0f), 1.0f) * (numVariations - 1);
+		uint32_t j = std::min((uint32_t)x, numVariations - 2);
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			float a = coloursRGB[j * 3 + c];
+			float b = coloursRGB[(j + 1) * 3 + c];
+			rgb[c] = a + (b - a) * (x - j);
+		}
+	}
+
+	std::vector<float> readRenderHistogram()
+	{
+		//read the main image of b_renderTexture back as float (r, g, b, count) per pixel, whatever format it was accumulated
+		//in. pixels are in the order of the histogram layout
+		uint32_t numPixels = getHistogramPixelCount(renderTexWidth, renderTexHeight);
+		std::vector<float> histogram(numPixels * 4);
+
+		uint32_t mode = renderDeepAccumulation ? ACCUMULATION_FIXED64 : renderAccumulationMode;
+		if (mode == ACCUMULATION_ENTRY_CHANNELS)
+		{
+			//colour each pixel with the current entry colours, the same as renderPostProcess
+			uint32_t numChannels = getHistogramPixelSize(mode);
+			std::vector<uint32_t> values(numPixels * numChannels);
+			CLManager::readBuffer(b_renderTexture, numPixels * numChannels, values.data());
+			for (uint32_t j = 0; j < numPixels; j++)
+			{
+				for (uint32_t e = 0; e < numChannels; e++)
+				{
+					float w = values[j * numChannels + e] / (float)ENTRY_CHANNEL_SCALE;
+					histogram[j * 4 + 0] += w * coloursRGB[e * 3 + 0];
+					histogram[j * 4 + 1] += w * coloursRGB[e * 3 + 1];
+					histogram[j * 4 + 2] += w * coloursRGB[e * 3 + 2];
+					histogram[j * 4 + 3] += w;
+				}
+			}
+		}
+		else if (mode == ACCUMULATION_PACKED_RGB || mode == ACCUMULATION_PALETTE)
+		{
+			std::vector<uint32_t> values(numPixels * 2);
+			CLManager::readBuffer(b_renderTexture, numPixels * 2, values.data());
+			for (uint32_t j = 0; j < numPixels; j++)
+			{
+				float count = (float)values[j * 2 + 1];
+				float rgb[3];
+				if (mode == ACCUMULATION_PACKED_RGB)
+				{
+					unpackRGB9E5(values[j * 2], rgb);
+				}
+				else if (count > 0.0f)
+				{
+					paletteColour(values[j * 2] / FIXED_POINT_SCALE_32 / count, rgb);
+					for (uint32_t c = 0; c < 3; c++) rgb[c] *= count;
+				}
+				else
+				{
+					rgb[0] = rgb[1] = rgb[2] = 0.0f;
+				}
+
+				histogram[j * 4 + 0] = rgb[0];
+				histogram[j * 4 + 1] = rgb[1];
+				histogram[j * 4 + 2] = rgb[2];
+				histogram[j * 4 + 3] = count;
+			}
+		}
+		else if (mode == ACCUMULATION_FIXED64)
+		{
+			std::vector<uint64_t> values(numPixels * 4);
+			CLManager::readBuffer(b_renderTexture, numPixels * 4, values.data());
+			for (uint32_t j = 0; j < numPixels * 4; j++)
+			{
+				histogram[j] = j % 4 == 3 ? (float)values[j] : values[j] / FIXED_POINT_SCALE_64;
+			}
+		}
+		else if (mode == ACCUMULATION_FIXED32)
+		{
+			std::vector<uint32_t> values(numPixels * 4);
+			CLManager::readBuffer(b_renderTexture, numPixels * 4, values.data());
+			for (uint32_t j = 0; j < numPixels * 4; j++)
+			{
+				histogram[j] = j % 4 == 3 ? (float)values[j] : values[j] / FIXED_POINT_SCALE_32;
+			}
+		}
+		else
+		{
+			CLManager::readBuffer(b_renderTexture, numPixels * 4, histogram.data());
+		}
+
+		return histogram;
+	}
+
+	float normalisedL1Difference(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		//sum of absolute differences between two histograms, after scaling each so its counts add up to 1. 0 is identical,
+		//2 is completely separate
+		double totalA = 0.0;
+		double totalB = 0.0;
+		for (size_t j = 3; j < a.size(); j += 4)
+		{
+			totalA += a[j];
+			totalB += b[j];
+		}
+
+		if (totalA <= 0.0 || totalB <= 0.0) return 0.0f;
+
+		double difference = 0.0;
+		for (size_t j = 0; j < a.size(); j++)
+		{
+			difference += std::abs(a[j] / totalA - b[j] / totalB);
+		}
+
+		//colour channels are summed as well as the count, so divide by the 4 channels to keep the range the same
+		return (float)(difference / 4.0);
+	}
+
+	std::vector<float> comparisonRender(const char* name, uint32_t numSamples, uint32_t firstFrame)
+	{
+		//produce a render's samples with the current kernel parameters and return the histogram, for comparing settings.
+		//the time taken is added to the benchmark results. extra views are plotted too, but only the main image is returned
+		createRenderHistogram(numSamples, false);
+
+		auto start = std::chrono::steady_clock::now();
+		produceRenderSamples(numSamples, binningMode, firstFrame, false);
+		auto end = std::chrono::steady_clock::now();
+
+		char result[128];
+		snprintf(result, sizeof(result), "%s: %.1f ms", name, std::chrono::duration<float, std::milli>(end - start).count());
+		benchmarkResults.push_back(result);
+		std::cout << "  " << result << std::endl;
+
+		std::vector<float> histogram = readRenderHistogram();
+		CLManager::deleteBuffer(b_renderTexture);
+		return histogram;
+	}
+
+	void compareChoiceModes()
+	{
+		//check that shared variation choice converges to the same image as independent choice. two independent renders
+		//with different start points give the difference expected from noise alone, and the shared choice render should
+		//be about as close to the first independent one as that
+		if (numRenderSamples == 0 || numVariations == 0) return;
+
+		std::cout << "Comparing variation choice modes with " << numRenderSamples << " samples at " << renderTexWidth << "x"
+			<< renderTexHeight << "..." << std::endl;
+		benchmarkResults.clear();
+
+		CLManager::setKernelParamValue(k_produceSamples, 31, CHOICE_INDEPENDENT);
+		std::vector<float> independent = comparisonRender("independent", numRenderSamples, 0);
+		std::vector<float> independentOther = comparisonRender("independent, other seed", numRenderSamples, 1 << 16);
+		CLManager::setKernelParamValue(k_produceSamples, 31, CHOICE_SHARED);
+		std::vector<float> shared = comparisonRender("shared", numRenderSamples, 1 << 17);
+
+		float noiseFloor = normalisedL1Difference(independent, independentOther);
+		float sharedDifference = normalisedL1Difference(independent, shared);
+
+		char result[128];
+		snprintf(result, sizeof(result), "L1 difference: %.5f noise floor, %.5f shared (%.2fx)", noiseFloor, sharedDifference,
+			noiseFloor > 0.0f ? sharedDifference / noiseFloor : 0.0f);
+		benchmarkResults.push_back(result);
+		std::cout << "  " << result << std::endl;
+
+		setPreviewKernelParams();
+	}
+
+	void compareSamplers()
+	{
+		//compare how close the random and low discrepancy samplers get to a reference render with many more samples, for
+		//the same number of samples. a lower difference means less noise
+		if (numRenderSamples == 0 || numVariations == 0) return;
+
+		const uint32_t referenceMultiplier = 8;
+		uint32_t referenceSamples = (uint32_t)std::min((uint64_t)numRenderSamples * referenceMultiplier, (uint64_t)UINT32_MAX);
+
+		std::cout << "Comparing samplers with " << numRenderSamples << " samples at " << renderTexWidth << "x"
+			<< renderTexHeight << "..." << std::endl;
+		benchmarkResults.clear();
+
+		CLManager::setKernelParamValue(k_produceSamples, 34, SAMPLER_RANDOM);
+		std::vector<float> reference = comparisonRender("reference", referenceSamples, 1 << 18);
+		std::vector<float> random = comparisonRender("random", numRenderSamples, 0);
+		CLManager::setKernelParamValue(k_produceSamples, 34, SAMPLER_LOW_DISCREPANCY);
+		std::vector<float> lowDiscrepancy = comparisonRender("low discrepancy", numRenderSamples, 0);
+
+		float randomDifference = normalisedL1Difference(reference, random);
+		float lowDiscrepancyDifference = normalisedL1Difference(reference, lowDiscrepancy);
+
+		char result[128];
+		snprintf(result, sizeof(result), "L1 difference to reference: %.5f random, %.5f low discrepancy", randomDifference,
+			lowDiscrepancyDifference);
+		benchmarkResults.push_back(result);
+		std::cout << "  " << result << std::endl;
+
+		setPreviewKernelParams();
+	}
+
+	void benchmarkTransformModes()
+	{
+		//time the render with the current list as variations and as affine maps. affine maps need no maths functions, so
+		//their rate is about the most the plotting side can handle
+		if (!startRenderBenchmark("transform modes")) return;
+
+		const char* names[] = { "variations", "affine maps" };
+		for (uint32_t mode = TRANSFORM_VARIATIONS; mode <= TRANSFORM_AFFINE; mode++)
+		{
+			CLManager::setKernelParamValue(k_produceSamples, 44, mode);
+			timeRender(names[mode], binningMode);
+		}
+
+		CLManager::setKernelParamValue(k_produceSamples, 44, transformMode);
+		setPreviewKernelParams();
+	}
+
+	void benchmarkDimensions()
+	{
+		//time the render in 2d and 3d. 3d points which are culled skip the histogram entirely, so the 3d time also depends
+		//on how much of the attractor is in view
+		if (!startRenderBenchmark("dimensions")) return;
+
+		const char* names[] = { "2d", "3d" };
+		uint32_t savedDimensions = dimensions;
+		for (uint32_t d = DIMENSIONS_2D; d <= DIMENSIONS_3D; d++)
+		{
+			dimensions = d;
+			CLManager::setKernelParamValue(k_produceSamples, 48, dimensions);
+			timeRender(names[d], binningMode);
+		}
+
+		dimensions = savedDimensions;
+		CLManager::setKernelParamValue(k_produceSamples, 48, dimensions);
+		setPreviewKernelParams();
+	}
+
+	void compareAccumulationFormats()
+	{
+		//render with each accumulation format and report its memory and how far its image is from the first, float.
+		//palette only keeps a position between the entry colours, so its error includes the colours it can't represent
+		if (numRenderSamples == 0 || numVariations == 0) return;
+
+		uint32_t savedMode = accumulationMode;
+
+		std::cout << "Comparing accumulation formats with " << numRenderSamples << " samples at " << renderTexWidth << "x"
+			<< renderTexHeight << "..." << std::endl;
+		benchmarkResults.clear();
+
+		std::vector<float> reference;
+		const char* referenceName = "";
+		for (uint32_t mode = 0; mode < IM_ARRAYSIZE(ACCUMULATION_NAMES); mode++)
+		{
+			if (mode == ACCUMULATION_FIXED64 && !supportsFixed64) continue;
+
+			accumulationMode = mode;
+			std::vector<float> histogram = comparisonRender(ACCUMULATION_NAMES[mode], numRenderSamples, 0);
+			//the render may have used a different mode, such as fixed64 for a long render, so the names are what actually ran
+			const char* ranName = renderDeepAccumulation ? "deep fixed32" : ACCUMULATION_NAMES[renderAccumulationMode];
+			if (reference.empty())
+			{
+				reference = histogram;
+				referenceName = ranName;
+			}
+
+			char result[160];
+			snprintf(result, sizeof(result), "%s: %u bytes per pixel, %.1f MB, difference from %s %.4f", ranName,
+				renderDeepAccumulation ? 8 * (uint32_t)sizeof(uint32_t) :
+				getHistogramPixelSize(renderAccumulationMode) * (uint32_t)sizeof(uint32_t),
+				getRenderHistogramMB(), referenceName, normalisedL1Difference(reference, histogram));
+			benchmarkResults.push_back(result);
+			std::cout << "  " << result << std::endl;
+		}
+
+		accumulationMode = savedMode;
+		setPreviewKernelParams();
+	}
+
+	void compareFastVariations()
+	{
+		//measure the error of each fast maths variation against the precise version over a grid of points, then render
+		//the current variations with each. two precise renders with different start points give the difference expected
+		//from noise alone, and the fast render should be about as close to the first precise one as that
+		const uint32_t gridSize = 512;
+		const float gridExtent = 4.0f;
+		const uint32_t numPoints = gridSize * gridSize;
+
+		std::string b_variationErrors = "variationErrors";
+		CLManager::createBuffer<float>(b_variationErrors, numPoints);
+		CLManager::setKernelRange(k_compareVariations, numPoints);
+		CLManager::setKernelParamBuffer(k_compareVariations, 0, { b_variationErrors });
+		CLManager::setKernelParamValue(k_compareVariations, 2, gridSize);
+		CLManager::setKernelParamValue(k_compareVariations, 3, gridExtent);
+
+		std::cout << "Comparing fast maths variations..." << std::endl;
+		benchmarkResults.clear();
+
+		std::vector<float> errors(numPoints);
+		for (uint32_t v : VALID_VARIATIONS)
+		{
+			if (v == 0) continue;
+
+			CLManager::setKernelParamValue(k_compareVariations, 1, v);
+			CLManager::runKernel(k_compareVariations);
+			CLManager::readBuffer(b_variationErrors, numPoints, errors.data());
+
+			float maxError = 0.0f;
+			double totalError = 0.0;
+			uint32_t numCompared = 0;
+			for (float e : errors)
+			{
+				if (e < 0.0f) continue;
+				maxError = std::max(maxError, e);
+				totalError += e;
+				numCompared++;
+			}
+
+			char result[128];
+			snprintf(result, sizeof(result), "v%u: max error %.2e, mean %.2e", v, maxError,
+				numCompared > 0 ? totalError / numCompared : 0.0);
+			benchmarkResults.push_back(result);
+			std::cout << "  " << result << std::endl;
+		}
+
+		CLManager::deleteBuffer(b_variationErrors);
+
+		if (numRenderSamples == 0 || numVariations == 0) return;
+
+		//the generic fast program is built here if it hasn't been yet, and kept for the fast maths checkbox to use
+		std::string fastKey = getProgramKey({}, true);
+		SpecialisedProgram& fastProgram = specialisedPrograms[fastKey];
+		if (!fastProgram.success)
+		{
+			fastProgram.success = CLManager::buildProgram(createKernelSource({}, true), fastProgram.program);
+			if (!fastProgram.success)
+			{
+				specialisedPrograms.erase(fastKey);
+				return;
+			}
+		}
+
+		CLManager::setKernelProgram(k_produceSamples, CLManager::program);
+		std::vector<float> precise = comparisonRender("precise", numRenderSamples, 0);
+		std::vector<float> preciseOther = comparisonRender("precise, other seed", numRenderSamples, 1 << 16);
+		CLManager::setKernelProgram(k_produceSamples, fastProgram.program);
+		std::vector<float> fast = comparisonRender("fast", numRenderSamples, 0);
+
+		float noiseFloor = normalisedL1Difference(precise, preciseOther);
+		float fastDifference = normalisedL1Difference(precise, fast);
+
+		char result[128];
+		snprintf(result, sizeof(result), "L1 difference: %.5f noise floor, %.5f fast (%.2fx)", noiseFloor, fastDifference,
+			noiseFloor > 0.0f ? fastDifference / noiseFloor : 0.0f);
+		benchmarkResults.push_back(result);
+		std::cout << "  " << result << std::endl;
+
+		//the generic fast program is still set, the next updateKernelSpecialisation swaps it if the settings want another
+		activeProgramKey = fastKey;
+		setPreviewKernelParams();
+	}
+
+	void destroy()
+	{
+		//a specialised program still compiling uses the CL context, so wait for it before the context goes
+		if (compilingProgram.valid()) compilingProgram.wait();
+		specialisedPrograms.clear();
 	}
 
 	float randomFloat()
@@ -725,6 +2791,20 @@ namespace ifs
 		return (uint32_t)(1 + randomFloat() * (MAX_VARIATIONS - 1));
 	}
 
+	float* randomAffineMap()
+	{
+		//linear part small enough that most random maps shrink points towards the attractor
+		static float map[AFFINE_MAP_SIZE];
+		for (uint32_t row = 0; row < 3; row++)
+		{
+			map[row * 4 + 0] = randomFloat() * 1.4f - 0.7f;
+			map[row * 4 + 1] = randomFloat() * 1.4f - 0.7f;
+			map[row * 4 + 2] = randomFloat() * 1.4f - 0.7f;
+			map[row * 4 + 3] = randomFloat() * 2.0f - 1.0f;
+		}
+		return map;
+	}
+
 	float* randomOKLCh()
 	{
 		//generate a random "sensible" colour in LCh space
@@ -3,15 +3,24 @@
 
 #include "glm/glm.hpp"
 
+#include <string>
+#include <vector>
+
 namespace ifs
 {
 	void acquireGLObjects();
 	void releaseGLObjects();
 	
 	void createPreviewTexture();
+	void setPreviewEntryColours();
 	
+	void setCameraKernelParams();
+	void setCameraMode(uint32_t mode);
 	void updateCam(const glm::vec2& deltaPos, const float deltaZoom);
 	void resetCam();
+	void setCamAngles(const glm::vec2& angles);
+	void setDimensions(uint32_t d);
+	void setFogDensity(float density);
 	float getCamZoom();
 	bool getPaused();
 
@@ -19,26 +28,77 @@ namespace ifs
 	void setNumPreviewSamples(uint32_t n);
 	void setInitialIterations(uint32_t n);
 	void setIterations(uint32_t n);
+	void setSymmetry(uint32_t order, bool mirror);
 	void setGamma(float g);
+	void setAccumulationMode(uint32_t mode);
+	void setBinningMode(uint32_t mode);
+	void setPreviewBinningParam();
+	void setSelectionMode(uint32_t mode);
+	void setExecutionMode(uint32_t mode);
+	void setChoiceMode(uint32_t mode);
+	void setSamplerMode(uint32_t mode);
+	void setTransformMode(uint32_t mode);
+	void setCountStatistics(bool count);
+	void setHistogramLayout(uint32_t layout);
+	uint32_t getHistogramPixelCount(uint32_t width, uint32_t height);
+	uint32_t getNumWorkItems(uint32_t numSamples);
+	uint32_t getHistogramPixelSize(uint32_t mode);
+	float getEntryChannelMB(uint32_t numPixels);
 	
 	void addDefaultVariation();
 	void addRandomVariation();
 	void removeVariation(uint32_t index);
+	bool isValidVariation(uint32_t variation);
 	void setVariationNum(uint32_t index, uint32_t variation);
 	void setVariationColour(uint32_t index, float L, float C, float h);
 	void setVariationWeight(uint32_t index, float w);
+	void setBlendVariation(uint32_t index, uint32_t slot, uint32_t variation);
+	void setBlendWeight(uint32_t index, uint32_t slot, float w);
+	void setVariationDepth(uint32_t index, float d);
+	void setAffineMap(uint32_t index, const float* map);
+	void loadAffinePreset(const float* maps, uint32_t n);
+	void buildAliasTable(const float* w, uint32_t n, float* probabilities, uint32_t* aliases);
+	void updateAliasTable();
 
 	void createGUI();
 	
 	bool init(uint32_t tw, uint32_t th);
 	void update();
+	void updateKernelSpecialisation();
+	std::string getProgramKey(const std::vector<std::vector<uint32_t>>& blends, bool fastVariations);
 	void clearSamples();
 	void draw();
 	void render();
+	void chooseRenderAccumulation(uint32_t numSamples);
+	float getRenderHistogramMB();
+	void createRenderHistogram(uint32_t numSamples, bool logMemory);
+	void readStatistics(uint32_t* dest);
+	void produceRenderSamples(uint32_t numSamples, uint32_t renderBinningMode, uint32_t firstFrame, bool logProgress);
+	uint32_t getNumRenderPixels();
+	void setRenderViewParams();
+	void setPreviewKernelParams();
+	bool startRenderBenchmark(const char* name);
+	float timeRender(const char* name, uint32_t renderBinningMode);
+	void benchmarkPlotting();
+	void unpackRGB9E5(uint32_t v, float* rgb);
+	void paletteColour(float t, float* rgb);
+	std::vector<float> readRenderHistogram();
+	float normalisedL1Difference(const std::vector<float>& a, const std::vector<float>& b);
+	std::vector<float> comparisonRender(const char* name, uint32_t numSamples, uint32_t firstFrame);
+	void compareChoiceModes();
+	void compareSamplers();
+	void benchmarkHistogramLayouts();
+	void benchmarkCameraModes();
+	void benchmarkSelection();
+	void benchmarkTransformModes();
+	void benchmarkDimensions();
+	void compareAccumulationFormats();
+	void compareFastVariations();
 	void destroy();
 
 	float randomFloat();
 	uint32_t randomVariationIndex();
+	float* randomAffineMap();
 	float* randomOKLCh();
 	float* OKLChtoRGB(float oklab[3]);
 
@@ -1,12 +1,85 @@
 
 #include "kernels.h"
 #include "KernelRString.h"
+#include "common_def.h"
 
 
-std::string createKernelSource()
+std::string createFastVariationSource(const std::string& variationSource)
+{
+	//copy of the variations named vN_fast, using native_ maths functions and the approximations in strFastMaths. these can
+	//be a few ulp out, or more for large arguments, so compareVariations measures them against the precise versions
+	std::string source = std::regex_replace(variationSource, std::regex("void v([0-9]+)\\("), "void v$1_fast(");
+	source = std::regex_replace(source, std::regex("\\bpolarCoordinates\\("), "polarCoordinates_fast(");
+	source = std::regex_replace(source, std::regex("\\b(sin|cos|tan|exp|sqrt)\\("), "native_$1(");
+	source = std::regex_replace(source, std::regex("\\bpow\\("), "native_powr(");
+	source = std::regex_replace(source, std::regex("\\bcosh\\("), "fastCosh(");
+	source = std::regex_replace(source, std::regex("\\bsinh\\("), "fastSinh(");
+	source = std::regex_replace(source, std::regex("\\batan2\\("), "fastAtan2(");
+	return source;
+}
+
+std::string createBlendSource(const std::vector<uint32_t>& blend, uint32_t r, const std::string& suffix)
+{
+	//entry r's blend with its variations written in. the weights are still read from blendWeights, so they can change
+	//without recompiling. whether the angle is needed is a constant the compiler can fold
+	std::string angle = "false";
+	std::string calls = "";
+	for (uint32_t b = 0; b < blend.size(); b++)
+	{
+		uint32_t v = blend[b];
+		if (v == UNUSED_BLEND_SLOT) continue;
+
+		std::string call = "";
+		if (v == 13) call = "v13" + suffix + "(&vp, q, seed); ";
+		else if (v != 0) call = "v" + std::to_string(v) + suffix + "(&vp, q); ";
+
+		std::string weight = "blendWeights[" + std::to_string(r * MAX_BLEND_VARIATIONS + b) + "u]";
+		angle += " || usesAngle(" + std::to_string(v) + "u)";
+		calls += "vp = *p; " + call + "sum += " + weight + " * vp; sumZ += " + weight + " * variationZ(" + std::to_string(v) + "u, q); ";
+	}
+
+	return "Polar q = polarCoordinates" + suffix + "(*p, *z, " + angle + "); float2 sum = (float2)(0.0f); float sumZ = 0.0f; "
+		"float2 vp; " + calls + "*p = sum; *z = sumZ; ";
+}
+
+std::string createSelectedVariationSource(const std::vector<std::vector<uint32_t>>& specialisedBlends, bool fastVariations)
+{
+	if (specialisedBlends.empty())
+	{
+		//generic version looks up which variations are in the chosen entry's blend, then compares them against every
+		//variation number
+		return std::string(" void applySelectedVariation(uint r, local uint* variations, local float* blendWeights, float2* p, ") +
+			"float* z, uint* seed) { " + (fastVariations ? "applyBlendFast" : "applyBlend") + "(r, variations, blendWeights, p, z, seed); } ";
+	}
+
+	//specialised version has the variations at each index written in, so it only compares against the few indices in use
+	std::string source = " void applySelectedVariation(uint r, local uint* variations, local float* blendWeights, float2* p, "
+		"float* z, uint* seed) { ";
+	std::string suffix = fastVariations ? "_fast" : "";
+	for (uint32_t r = 0; r < specialisedBlends.size(); r++)
+	{
+		std::string call = createBlendSource(specialisedBlends[r], r, suffix);
+
+		if (r == 0 && specialisedBlends.size() == 1) source += "{ " + call + " } ";
+		else if (r == 0) source += "if (r == " + std::to_string(r) + "u) { " + call + " } ";
+		else if (r < specialisedBlends.size() - 1) source += "else if (r == " + std::to_string(r) + "u) { " + call + " } ";
+		else source += "else { " + call + " } ";
+	}
+	source += "} ";
+
+	return source;
+}
+
+std::string createKernelSource(const std::vector<std::vector<uint32_t>>& specialisedBlends, bool fastVariations)
 {
 std::string strPreProc = "\
-#include \"common_def.h\"\
+#include \"common_def.h\"\n\
+#ifdef cl_khr_int64_base_atomics\n\
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable\n\
+#endif\n\
+#ifdef cl_khr_fp64\n\
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n\
+#endif\n\
 ";
 
 
@@ -31,6 +104,404 @@ void atomicAddFloat(volatile global float* addr, float val)
 }
 );
 
+//only used for ACCUMULATION_FIXED64, which the host doesn't allow unless the device supports 64 bit atomics
+std::string strAtomicAddULong = KERNEL_R_STRING(
+void atomicAddULong(volatile global ulong* addr, ulong val)
+{
+)+"#ifdef cl_khr_int64_base_atomics"+KERNEL_R_STRING(
+	atom_add(addr, val);
+)+"#endif"+KERNEL_R_STRING(
+}
+);
+
+std::string strAccumulation = KERNEL_R_STRING(
+uint histogramIndex(uint x, uint y, uint texWidth, uint histogramLayout)
+{
+	//position of pixel (x, y) in the histogram
+	if (histogramLayout == LAYOUT_TILED)
+	{
+		uint tilesX = (texWidth + HISTOGRAM_TILE_SIZE - 1) >> HISTOGRAM_TILE_BITS;
+		uint tile = (y >> HISTOGRAM_TILE_BITS) * tilesX + (x >> HISTOGRAM_TILE_BITS);
+		uint inTile = ((y & (HISTOGRAM_TILE_SIZE - 1)) << HISTOGRAM_TILE_BITS) | (x & (HISTOGRAM_TILE_SIZE - 1));
+		return (tile << (2 * HISTOGRAM_TILE_BITS)) | inTile;
+	}
+
+	return y * texWidth + x;
+}
+
+uint packRGB9E5(float3 v, uint seed)
+{
+	//shared exponent from the largest channel, then each mantissa rounded up with probability equal to the part which
+	//doesn't fit, so the packed value is right on average. sums too small for the smallest exponent are dropped, sums past
+	//511 * 2^16 (about 2^25) saturate, which 2^24 samples of colours up to 1 can't reach
+	float largest = max(v.x, max(v.y, v.z));
+	if (largest <= 0.0f) return 0;
+
+	int e;
+	frexp(largest, &e);
+	float3 rounding = (float3)(RNG(&seed), RNG(&seed), RNG(&seed));
+	float3 m = floor(v * ldexp(1.0f, PACKED_MANTISSA_BITS - e) + rounding);
+	if (any(m >= (float)(1 << PACKED_MANTISSA_BITS)))
+	{
+		e++;
+		m = floor(v * ldexp(1.0f, PACKED_MANTISSA_BITS - e) + rounding);
+	}
+
+	int exponent = e + PACKED_EXPONENT_BIAS;
+	if (exponent < 0) return 0;
+	if (exponent > 31)
+	{
+		exponent = 31;
+		m = floor(v * ldexp(1.0f, PACKED_MANTISSA_BITS + PACKED_EXPONENT_BIAS - 31) + rounding);
+		m = min(m, (float3)((1 << PACKED_MANTISSA_BITS) - 1));
+	}
+
+	uint3 mantissa = convert_uint3(m);
+	return (mantissa.x << 23) | (mantissa.y << 14) | (mantissa.z << 5) | (uint)exponent;
+}
+
+float3 unpackRGB9E5(uint v)
+{
+	//9 bit mantissas for r, g and b in the top 27 bits, shared exponent in the bottom 5
+	uint3 mantissa = (uint3)(v >> 23, v >> 14, v >> 5) & ((1u << PACKED_MANTISSA_BITS) - 1);
+	int exponent = v & 31;
+	return convert_float3(mantissa) * ldexp(1.0f, exponent - PACKED_EXPONENT_BIAS - PACKED_MANTISSA_BITS);
+}
+
+void atomicAddPackedRGB(volatile global uint* addr, float3 c)
+{
+	//same as atomicAddFloat, but for a packed colour sum. the rounding is seeded from the pixel's current value and the
+	//sample, so it changes with every sample added
+	uint current = *addr;
+	uint expected;
+	do
+	{
+		expected = current;
+		uint seed = hashUint(expected ^ hashUint(as_uint(c.x) ^ hashUint(as_uint(c.y) ^ as_uint(c.z))));
+		uint next = packRGB9E5(unpackRGB9E5(expected) + c, seed);
+		current = atomic_cmpxchg(addr, expected, next);
+	} while (current != expected);
+}
+
+uint historyEntry(uint history, uint k)
+{
+	//entry chosen k iterations ago, from a history kept by iterate()
+	return (history >> (k * ENTRY_HISTORY_BITS)) & ((1u << ENTRY_HISTORY_BITS) - 1);
+}
+
+uint historyWeight(uint k)
+{
+	//share of a sample given to the entry chosen k iterations ago, out of ENTRY_CHANNEL_SCALE. the two oldest get the same
+	//weight so that the weights add up to ENTRY_CHANNEL_SCALE
+	return (ENTRY_CHANNEL_SCALE >> 1) >> min(k, (uint)ENTRY_HISTORY_LENGTH - 2);
+}
+
+float paletteCoordinate(uint history, uint numEntries)
+{
+	//position along the palette in [0, 1], where entry j sits at j / (numEntries - 1). blended from the recent entries
+	//the same way the colour is
+	if (numEntries < 2) return 0.0f;
+
+	uint sum = 0;
+	for (uint k = 0; k < ENTRY_HISTORY_LENGTH; k++)
+	{
+		sum += min(historyEntry(history, k), numEntries - 1) * historyWeight(k);
+	}
+
+	return sum / (float)(ENTRY_CHANNEL_SCALE * (numEntries - 1));
+}
+
+float3 paletteColour(global float* colours, uint numEntries, float t)
+{
+	//linear interpolation between the entry colours in list order
+	if (numEntries < 2) return (float3)(colours[0], colours[1], colours[2]);
+
+	float x = clamp(t, 0.0f, 1.0f) * (numEntries - 1);
+	uint j = min((uint)x, numEntries - 2);
+	float3 a = (float3)(colours[j * 3 + 0], colours[j * 3 + 1], colours[j * 3 + 2]);
+	float3 b = (float3)(colours[j * 3 + 3], colours[j * 3 + 4], colours[j * 3 + 5]);
+	return mix(a, b, x - j);
+}
+
+bool saturated(volatile global uint* count, uint hits)
+{
+	//whether adding hits to a 32 bit fixed point pixel would take it past FIXED32_SATURATION_HITS, where its colour sums
+	//could soon wrap round and turn it dark. not atomic with the add, the gap below the real limit covers adds racing it
+	return *count + hits > FIXED32_SATURATION_HITS;
+}
+
+void accumulate(global float* renderTexture, uint pixelIndex, float3 c, uint accumulationMode)
+{
+	//add one sample of colour c to the histogram, in the storage format given by accumulationMode
+
+	if (accumulationMode == ACCUMULATION_FIXED32)
+	{
+		volatile global uint* tex = (volatile global uint*)renderTexture;
+		if (saturated(&tex[pixelIndex * 4 + 3], 1)) return;
+		uint3 cFixed = convert_uint3_rte(c * FIXED_POINT_SCALE_32);
+		atomic_add(&tex[pixelIndex * 4 + 0], cFixed.x);
+		atomic_add(&tex[pixelIndex * 4 + 1], cFixed.y);
+		atomic_add(&tex[pixelIndex * 4 + 2], cFixed.z);
+		atomic_inc(&tex[pixelIndex * 4 + 3]);
+	}
+	else if (accumulationMode == ACCUMULATION_PACKED_RGB)
+	{
+		volatile global uint* tex = (volatile global uint*)renderTexture;
+		atomicAddPackedRGB(&tex[pixelIndex * 2 + 0], c);
+		atomic_inc(&tex[pixelIndex * 2 + 1]);
+	}
+	else if (accumulationMode == ACCUMULATION_PALETTE)
+	{
+		//plot() puts the palette coordinate in c.x
+		volatile global uint* tex = (volatile global uint*)renderTexture;
+		if (saturated(&tex[pixelIndex * 2 + 1], 1)) return;
+		atomic_add(&tex[pixelIndex * 2 + 0], convert_uint_rte(c.x * FIXED_POINT_SCALE_32));
+		atomic_inc(&tex[pixelIndex * 2 + 1]);
+	}
+	else if (accumulationMode == ACCUMULATION_FIXED64)
+	{
+		volatile global ulong* tex = (volatile global ulong*)renderTexture;
+		ulong3 cFixed = convert_ulong3_rte(c * FIXED_POINT_SCALE_64);
+		atomicAddULong(&tex[pixelIndex * 4 + 0], cFixed.x);
+		atomicAddULong(&tex[pixelIndex * 4 + 1], cFixed.y);
+		atomicAddULong(&tex[pixelIndex * 4 + 2], cFixed.z);
+		atomicAddULong(&tex[pixelIndex * 4 + 3], 1);
+	}
+	else
+	{
+		atomicAddFloat(&renderTexture[pixelIndex * 4 + 0], c.x);
+		atomicAddFloat(&renderTexture[pixelIndex * 4 + 1], c.y);
+		atomicAddFloat(&renderTexture[pixelIndex * 4 + 2], c.z);
+		atomicAddFloat(&renderTexture[pixelIndex * 4 + 3], 1.0f);
+	}
+}
+
+float4 readAccumulation(global float* renderTexture, uint pixelIndex, uint accumulationMode)
+{
+	//convert a histogram pixel back to float (r, g, b, count), whatever format it was accumulated in. the palette format
+	//gives (coordinate sum, 0, 0, count)
+	if (accumulationMode == ACCUMULATION_PACKED_RGB)
+	{
+		uint2 pix = vload2(pixelIndex, (global uint*)renderTexture);
+		return (float4)(unpackRGB9E5(pix.x), convert_float(pix.y));
+	}
+	else if (accumulationMode == ACCUMULATION_PALETTE)
+	{
+		uint2 pix = vload2(pixelIndex, (global uint*)renderTexture);
+		return (float4)(pix.x / FIXED_POINT_SCALE_32, 0.0f, 0.0f, convert_float(pix.y));
+	}
+
+	if (accumulationMode == ACCUMULATION_FIXED32)
+	{
+		uint4 pix = vload4(pixelIndex, (global uint*)renderTexture);
+		return (float4)(convert_float3(pix.xyz) / FIXED_POINT_SCALE_32, convert_float(pix.w));
+	}
+	else if (accumulationMode == ACCUMULATION_FIXED64)
+	{
+		ulong4 pix = vload4(pixelIndex, (global ulong*)renderTexture);
+		return (float4)(convert_float3(pix.xyz) / FIXED_POINT_SCALE_64, convert_float(pix.w));
+	}
+
+	return vload4(pixelIndex, renderTexture);
+}
+
+void accumulateEntries(global float* renderTexture, uint pixelIndex, uint history, uint numChannels)
+{
+	//add one sample to the per-entry channels, split between the entries in the point's history the same way its colour
+	//would have been blended. runs of the same entry are added with one atomic
+	volatile global uint* tex = (volatile global uint*)renderTexture;
+	uint weight = 0;
+	for (uint k = 0; k < ENTRY_HISTORY_LENGTH; k++)
+	{
+		uint entry = historyEntry(history, k);
+		weight += historyWeight(k);
+
+		if (k == ENTRY_HISTORY_LENGTH - 1 || historyEntry(history, k + 1) != entry)
+		{
+			//each channel stops short of wrapping like fixed32 does
+			volatile global uint* channel = &tex[pixelIndex * numChannels + min(entry, numChannels - 1)];
+			if (*channel <= ENTRY_CHANNEL_SATURATION) atomic_add(channel, weight);
+			weight = 0;
+		}
+	}
+}
+
+float4 readEntryChannels(global float* renderTexture, uint pixelIndex, global float* colours, uint numChannels)
+{
+	//turn a pixel of per-entry channels into float (r, g, b, count) using the current colour of each entry
+	global uint* tex = (global uint*)renderTexture;
+	float4 pix = (float4)(0.0f);
+	for (uint j = 0; j < numChannels; j++)
+	{
+		float w = convert_float(tex[pixelIndex * numChannels + j]);
+		pix += w * (float4)(colours[j * 3 + 0], colours[j * 3 + 1], colours[j * 3 + 2], 1.0f);
+	}
+
+	return pix / (float)ENTRY_CHANNEL_SCALE;
+}
+);
+
+std::string strLocalCache = KERNEL_R_STRING(
+void atomicAddFloatLocal(volatile local float* addr, float val)
+{
+	//same as atomicAddFloat, but for the work group's local memory
+	union
+	{
+		unsigned int u32;
+		float f32;
+	} next, expected, current;
+
+	current.f32 = *addr;
+
+	do
+	{
+		expected.f32 = current.f32;
+		next.f32 = expected.f32 + val;
+		current.u32 = atomic_cmpxchg((volatile local unsigned int*)addr, expected.u32, next.u32);
+	} while (current.u32 != expected.u32);
+}
+
+void atomicAddULongLocal(volatile local ulong* addr, ulong val)
+{
+)+"#ifdef cl_khr_int64_base_atomics"+KERNEL_R_STRING(
+	atom_add(addr, val);
+)+"#endif"+KERNEL_R_STRING(
+}
+
+uint localCacheSlot(uint pixelIndex)
+{
+	//multiplicative hash, so that pixels near each other don't all compete for the same few slots
+	return (pixelIndex * 2654435761u) >> (32 - LOCAL_CACHE_BITS);
+}
+
+void clearLocalCache(local uint* lc_cacheTags, local uint* lc_cacheValues)
+{
+	for (uint j = get_local_id(0); j < LOCAL_CACHE_SIZE; j += get_local_size(0))
+	{
+		lc_cacheTags[j] = UINT_MAX;
+		vstore8((uint8)(0), j, lc_cacheValues);
+	}
+}
+
+void accumulateLocalSlot(local uint* slotValues, float3 c, uint accumulationMode)
+{
+	//slots are 8 uints so there is room for 4 channels in any accumulation mode. values are quantised in the same way
+	//as accumulate() so the result doesn't depend on which samples made it into local memory. the palette format is summed
+	//like fixed32 and packed rgb like float, and only packed when added to the histogram
+	if (accumulationMode == ACCUMULATION_FIXED32 || accumulationMode == ACCUMULATION_PALETTE)
+	{
+		volatile local uint* values = slotValues;
+		uint3 cFixed = convert_uint3_rte(c * FIXED_POINT_SCALE_32);
+		atomic_add(&values[0], cFixed.x);
+		atomic_add(&values[1], cFixed.y);
+		atomic_add(&values[2], cFixed.z);
+		atomic_inc(&values[3]);
+	}
+	else if (accumulationMode == ACCUMULATION_FIXED64)
+	{
+		volatile local ulong* values = (volatile local ulong*)slotValues;
+		ulong3 cFixed = convert_ulong3_rte(c * FIXED_POINT_SCALE_64);
+		atomicAddULongLocal(&values[0], cFixed.x);
+		atomicAddULongLocal(&values[1], cFixed.y);
+		atomicAddULongLocal(&values[2], cFixed.z);
+		atomicAddULongLocal(&values[3], 1);
+	}
+	else
+	{
+		volatile local float* values = (volatile local float*)slotValues;
+		atomicAddFloatLocal(&values[0], c.x);
+		atomicAddFloatLocal(&values[1], c.y);
+		atomicAddFloatLocal(&values[2], c.z);
+		atomicAddFloatLocal(&values[3], 1.0f);
+	}
+}
+
+void accumulateLocalCache(global float* renderTexture, uint pixelIndex, float3 c, uint accumulationMode,
+	local uint* lc_cacheTags, local uint* lc_cacheValues)
+{
+	//add the sample to the work group's cache, which is written to the histogram once all samples are plotted. each slot
+	//holds one pixel (the first one to claim it). a pixel tries LOCAL_CACHE_PROBES neighbouring slots, so two hot pixels
+	//sharing a hash can both be cached, and if other pixels have all of them then it goes straight to the histogram
+
+	uint slot = localCacheSlot(pixelIndex);
+	for (uint j = 0; j < LOCAL_CACHE_PROBES; j++)
+	{
+		uint tag = atomic_cmpxchg(&lc_cacheTags[slot], UINT_MAX, pixelIndex);
+		if (tag == UINT_MAX || tag == pixelIndex)
+		{
+			accumulateLocalSlot(&lc_cacheValues[slot * 8], c, accumulationMode);
+			return;
+		}
+
+		slot = (slot + 1) & (LOCAL_CACHE_SIZE - 1);
+	}
+
+	accumulate(renderTexture, pixelIndex, c, accumulationMode);
+}
+
+void flushLocalCache(global float* renderTexture, uint accumulationMode, local uint* lc_cacheTags, local uint* lc_cacheValues,
+	local uint* lc_statistics)
+{
+	//write every used slot of the cache to the histogram, with one global atomic per channel. the slots are shared out
+	//between the work items of the group. every sample in a slot after the first was merged into it
+	uint mergedHits = 0;
+	for (uint j = get_local_id(0); j < LOCAL_CACHE_SIZE; j += get_local_size(0))
+	{
+		uint pixelIndex = lc_cacheTags[j];
+		if (pixelIndex == UINT_MAX) continue;
+
+		if (accumulationMode == ACCUMULATION_FIXED64)
+		{
+			mergedHits += (uint)((local ulong*)lc_cacheValues)[j * 4 + 3] - 1;
+		}
+		else if (accumulationMode == ACCUMULATION_FIXED32 || accumulationMode == ACCUMULATION_PALETTE)
+		{
+			mergedHits += lc_cacheValues[j * 8 + 3] - 1;
+		}
+		else
+		{
+			mergedHits += (uint)((local float*)lc_cacheValues)[j * 8 + 3] - 1;
+		}
+
+		volatile global uint* tex = (volatile global uint*)renderTexture;
+		if (accumulationMode == ACCUMULATION_PACKED_RGB)
+		{
+			local float* values = (local float*)&lc_cacheValues[j * 8];
+			atomicAddPackedRGB(&tex[pixelIndex * 2 + 0], (float3)(values[0], values[1], values[2]));
+			atomic_add(&tex[pixelIndex * 2 + 1], (uint)values[3]);
+			continue;
+		}
+		else if (accumulationMode == ACCUMULATION_PALETTE)
+		{
+			if (saturated(&tex[pixelIndex * 2 + 1], lc_cacheValues[j * 8 + 3])) continue;
+			atomic_add(&tex[pixelIndex * 2 + 0], lc_cacheValues[j * 8 + 0]);
+			atomic_add(&tex[pixelIndex * 2 + 1], lc_cacheValues[j * 8 + 3]);
+			continue;
+		}
+
+		if (accumulationMode == ACCUMULATION_FIXED32 && saturated(&tex[pixelIndex * 4 + 3], lc_cacheValues[j * 8 + 3])) continue;
+
+		for (uint k = 0; k < 4; k++)
+		{
+			if (accumulationMode == ACCUMULATION_FIXED32)
+			{
+				atomic_add(&((volatile global uint*)renderTexture)[pixelIndex * 4 + k], lc_cacheValues[j * 8 + k]);
+			}
+			else if (accumulationMode == ACCUMULATION_FIXED64)
+			{
+				atomicAddULong(&((volatile global ulong*)renderTexture)[pixelIndex * 4 + k], ((local ulong*)lc_cacheValues)[j * 4 + k]);
+			}
+			else
+			{
+				atomicAddFloat(&renderTexture[pixelIndex * 4 + k], ((local float*)lc_cacheValues)[j * 8 + k]);
+			}
+		}
+	}
+
+	if (mergedHits > 0) atomic_add(&lc_statistics[STAT_MERGED_HITS], mergedHits);
+}
+);
+
 std::string strMat4MulVec4 = KERNEL_R_STRING(
 float4 mat4MulVec4(float16 mat, float4 vec)
 {
@@ -54,222 +525,305 @@ float RNG(uint* seed)
 }
 );
 
-std::string strSierpinskiTriangle = KERNEL_R_STRING(
-float2 sierpinskiTriangle(float2 p, uint* seed, uint iterations)
+std::string strSampler = KERNEL_R_STRING(
+uint hashUint(uint x)
+{
+	//same permutation as RNG, as a one off hash
+	uint state = x * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+uint streamSeed(ulong streamIndex)
+{
+	//seed for the sample point with this index over the whole render. both halves of the index are hashed in, so seeds
+	//don't repeat in step once frameNum * numSamples goes past 32 bits, though with 32 bit seeds some points will share one
+	return hashUint((uint)streamIndex ^ hashUint((uint)(streamIndex >> 32)));
+}
+
+float2 r2Point(ulong n)
 {
-	for (uint i = 0; i < iterations; i++)
+	//nth point of the R2 sequence (http://extremelearning.com.au/unreasonable-effectiveness-of-quasirandom-sequences/).
+	//the step sizes are 0.64 fixed point, so the sequence stays exact for any 64 bit n instead of losing float precision
+	ulong x = n * 0xC13FA9A902A6328Ful + 0x8000000000000000ul;
+	ulong y = n * 0x91E10DA5C79E7B1Cul + 0x8000000000000000ul;
+	return convert_float2((uint2)((uint)(x >> 40), (uint)(y >> 40))) / 16777216.0f;
+}
+
+uint permuteIndex(uint i, uint n, uint key)
+{
+	//bijection of [0, n) chosen by key. an invertible hash of the bits below n's top bit, repeated on results past n until
+	//one lands inside, so every index still comes out exactly once
+	if (i >= n || n < 2) return i;
+
+	uint bits = 32 - clz(n - 1);
+	uint mask = 0xFFFFFFFFu >> (32 - bits);
+	uint shift = max(bits / 2, 1u);
+	uint x = i;
+	do
 	{
-		float2 target;
-		float r = RNG(seed);
-		if (r < 0.33f)
-		{
-			target = (float2)(0, 0);
-		}
-		else if (r < 0.66f)
-		{
-			target = (float2)(0.5, sqrt(0.75)) * 10.0f;
-		}
-		else
-		{
-			target = (float2)(1, 0) * 10.0f;
-		}
+		x = ((x ^ key) * 0x2C1B3C6Du) & mask;
+		x ^= x >> shift;
+		x = (x * 0x297A2D39u + (key >> 16)) & mask;
+	} while (x >= n);
 
-		p = 0.5f * (p + target);
-	}
+	return x;
+}
 
-	return p;
+float stratifiedUniform(uint pointIndex, uint numPoints, uint rotation)
+{
+	//R1 sequence over the point index, shifted by a rotation shared by every point, so all the points together cover
+	//[0, 1) evenly. the index is shuffled by a new permutation each iteration, otherwise points next to each other in the
+	//sequence would pick the same variation every iteration and end up on the same orbit
+	uint x = permuteIndex(pointIndex, numPoints, hashUint(rotation)) * 2654435769u + rotation;
+	return (x >> 8) / 16777216.0f;
 }
 );
 
-std::string strMengerSponge = KERNEL_R_STRING(
-float2 mengerSponge(float2 p, uint* seed, uint iterations)
+std::string strFastMaths = KERNEL_R_STRING(
+float fastAtan2(float y, float x)
 {
-	const float one_third = 1.0f / 3.0f;
-	const float two_third = 2.0f * one_third;
-	for (uint i = 0; i < iterations; i++)
-	{
-		float2 target;
-		float r = RNG(seed);
-		if		(r < 0.125f) target = (float2)(0.000f, 0.0f);
-		else if (r < 0.25f)	 target = (float2)(one_third, 0.0f);
-		else if (r < 0.375f) target = (float2)(two_third, 0.0f);
-		else if (r < 0.5f)   target = (float2)(0.000f, one_third);
-		else if (r < 0.625f) target = (float2)(two_third, one_third);
-		else if (r < 0.75f)  target = (float2)(0.000f, two_third);
-		else if (r < 0.875f) target = (float2)(one_third, two_third);
-		else				 target = (float2)(two_third, two_third);
+	//polynomial arctangent of the smaller over the larger of |x| and |y|, max error about 1e-5 radians
+	float2 a = fabs((float2)(x, y));
+	float t = min(a.x, a.y) / max(max(a.x, a.y), FLT_MIN);
+	float s = t * t;
+	float r = ((-0.0464964749f * s + 0.15931422f) * s - 0.327622764f) * s * t + t;
+	if (a.y > a.x) r = 0.5f * PI - r;
+	if (x < 0.0f) r = PI - r;
+	return y < 0.0f ? -r : r;
+}
 
-		p = one_third * p + target;
-	}
+float fastCosh(float x)
+{
+	float e = native_exp(x);
+	return 0.5f * (e + native_recip(e));
+}
 
-	return p;
+float fastSinh(float x)
+{
+	float e = native_exp(x);
+	return 0.5f * (e - native_recip(e));
+}
+);
+
+std::string strPolar = KERNEL_R_STRING(
+typedef struct
+{
+	float r;
+	float r2;
+	float theta;
+	float sinTheta;
+	float cosTheta;
+	float z;
+	float r2xyz;
+} Polar;
+
+bool usesAngle(uint v)
+{
+	//variations which use theta or its sin and cos, the rest only need r
+	return (v >= 5 && v <= 13) || v == 19;
+}
+
+float variationZ(uint v, Polar q)
+{
+	//z of variation v's 3d form. sinusoidal takes the sine of z and spherical divides it by the 3d radius squared like x
+	//and y, the rest carry it through as linear does. 2d points have a z of 0, which stays 0
+	if (v == 1) return sin(q.z);
+	if (v == 2) return q.z / q.r2xyz;
+	return q.z;
 }
 );
 
 //https://flam3.com/flame_draves.pdf
 std::string strVariations = KERNEL_R_STRING(
-void v1(float2* p)
+Polar polarCoordinates(float2 p, float z, bool withAngle)
+{
+	//values shared by all the variations of a blend, worked out once per iteration. theta is measured from the y axis as
+	//in the flam3 paper, so its sin and cos are x / r and y / r. the angle is only worked out if a variation needs it.
+	//r2xyz includes the point's depth, for the variations with a 3d form
+	Polar q;
+	q.r2 = dot(p, p);
+	q.z = z;
+	q.r2xyz = q.r2 + z * z;
+	q.r = sqrt(q.r2);
+	q.theta = 0.0f;
+	q.sinTheta = 0.0f;
+	q.cosTheta = 1.0f;
+
+	if (withAngle && q.r > 0.0f)
+	{
+		q.theta = atan2(p.x, p.y);
+		q.sinTheta = p.x / q.r;
+		q.cosTheta = p.y / q.r;
+	}
+
+	return q;
+}
+
+void v1(float2* p, Polar q)
 {
 	p->x = sin(p->x);
 	p->y = sin(p->y);
 }
 
-void v2(float2* p)
+void v2(float2* p, Polar q)
 {
-	float r = length(*p);
-	float r2Inv = 1.0f / (r * r);
-	*p *= r2Inv;
+	*p *= 1.0f / q.r2xyz;
 }
 
-void v3(float2* p)
+void v3(float2* p, Polar q)
 {
-	float r2 = dot(*p, *p);
-	*p = (float2)(p->x * sin(r2) - p->y * cos(r2), p->x * cos(r2) + p->y * sin(r2));
+	*p = (float2)(p->x * sin(q.r2xyz) - p->y * cos(q.r2xyz), p->x * cos(q.r2xyz) + p->y * sin(q.r2xyz));
 }
 
-void v4(float2* p)
+void v4(float2* p, Polar q)
 {
-	float r = length(*p);
-	*p = 1.0f / r * (float2)((p->x - p->y) * (p->x + p->y), 2.0f * p->x * p->y);
+	*p = 1.0f / q.r * (float2)((p->x - p->y) * (p->x + p->y), 2.0f * p->x * p->y);
 }
 
-void v5(float2* p)
+void v5(float2* p, Polar q)
 {
-	float r = length(*p);
-	float theta = atan2(p->x, p->y);
-	p->x = theta / PI;
-	p->y = r - 1.0f;
+	p->x = q.theta / PI;
+	p->y = q.r - 1.0f;
 }
 
-void v6(float2* p)
+void v6(float2* p, Polar q)
 {
-	float r = length(*p);
-	float theta = atan2(p->x, p->y);
-	p->x = r * sin(theta + r);
-	p->y = r * cos(theta - r);
+	p->x = q.r * sin(q.theta + q.r);
+	p->y = q.r * cos(q.theta - q.r);
 }
 
-void v7(float2* p)
+void v7(float2* p, Polar q)
 {
-	float r = length(*p);
-	float theta = atan2(p->x, p->y);
-	p->x = r * sin(theta * r);
-	p->y = r * -cos(theta * r);
+	p->x = q.r * sin(q.theta * q.r);
+	p->y = q.r * -cos(q.theta * q.r);
 }
 
-void v8(float2* p)
+void v8(float2* p, Polar q)
 {
-	float r = length(*p);
-	float theta = atan2(p->x, p->y);
-	p->x = sin(PI * r);
-	p->y = cos(PI * r);
-	*p *= theta / PI;
+	p->x = sin(PI * q.r);
+	p->y = cos(PI * q.r);
+	*p *= q.theta / PI;
 }
 
-void v9(float2* p)
+void v9(float2* p, Polar q)
 {
-	float r = length(*p);
-	float theta = atan2(p->x, p->y);
-	p->x = cos(theta) + sin(r);
-	p->y = sin(theta) - cos(r);
-	*p *= 1.0f / r;
+	p->x = q.cosTheta + sin(q.r);
+	p->y = q.sinTheta - cos(q.r);
+	*p *= 1.0f / q.r;
 }
 
-void v10(float2* p)
+void v10(float2* p, Polar q)
 {
-	float r = length(*p);
-	float theta = atan2(p->x, p->y);
-	p->x = sin(theta) / r;
-	p->y = r * cos(theta);
+	p->x = q.sinTheta / q.r;
+	p->y = q.r * q.cosTheta;
 }
 
-void v11(float2* p)
+void v11(float2* p, Polar q)
 {
-	float r = length(*p);
-	float theta = atan2(p->x, p->y);
-	p->x = sin(theta) * cos(r);
-	p->y = cos(theta) * sin(r);
+	p->x = q.sinTheta * cos(q.r);
+	p->y = q.cosTheta * sin(q.r);
 }
 
-void v12(float2* p)
+void v12(float2* p, Polar q)
 {
-	float r = length(*p);
-	float theta = atan2(p->x, p->y);
-	float p0 = sin(theta + r);
-	float p1 = cos(theta - r);
+	float p0 = sin(q.theta + q.r);
+	float p1 = cos(q.theta - q.r);
 	p0 *= p0 * p0;
 	p1 *= p1 * p1;
 	p->x = p0 + p1;
 	p->y = p0 - p1;
-	*p *= r;
+	*p *= q.r;
 }
 
-void v13(float2* p, uint* seed)
+void v13(float2* p, Polar q, uint* seed)
 {
-	float r = length(*p);
-	float theta = atan2(p->x, p->y);
 	float omega = RNG(seed) < 0.5f ? 0.0f : PI;
-	p->x = cos(theta * 0.5f + omega);
-	p->y = sin(theta * 0.5f + omega);
-	*p *= sqrt(r);
+	p->x = cos(q.theta * 0.5f + omega);
+	p->y = sin(q.theta * 0.5f + omega);
+	*p *= sqrt(q.r);
 }
 
-void v14(float2* p)
+void v14(float2* p, Polar q)
 {
 	if (p->x < 0.0f) p->x *= 2.0f;
 	if (p->y < 0.0f) p->y *= 0.5f;
 }
 
-void v18(float2* p)
+void v18(float2* p, Polar q)
 {
 	*p = exp(p->x - 1.0f) * (float2)(cos(p->y * PI), sin(p->y * PI));
 }
 
-void v19(float2* p)
+void v19(float2* p, Polar q)
 {
-	float r = length(*p);
-	float theta = atan2(p->x, p->y);
-	p->x = cos(theta);
-	p->y = sin(theta);
-	*p *= pow(r, sin(theta));
+	p->x = q.cosTheta;
+	p->y = q.sinTheta;
+	*p *= pow(q.r, q.sinTheta);
 }
 
-void v20(float2* p)
+void v20(float2* p, Polar q)
 {
 	*p = (float2)(cos(PI * p->x) * cosh(p->y), -sin(PI * p->x) * sinh(p->y));
 }
 
-void v28(float2* p)
+void v28(float2* p, Polar q)
 {
-	float r2 = dot(*p, *p);
-	*p *= 4.0f / (r2 + 4);
+	*p *= 4.0f / (q.r2 + 4);
 }
 
-void v29(float2* p)
+void v29(float2* p, Polar q)
 {
 	p->x = sin(p->x);
 }
 
-void v42(float2* p)
+void v42(float2* p, Polar q)
 {
 	p->x = sin(p->x) / cos(p->y);
 	p->y = tan(p->y);
 }
 
-void v48(float2* p)
+void v48(float2* p, Polar q)
 {
 	float a = sqrt(1.0f / ((p->x * p->x - p->y * p->y) * (p->x * p->x - p->y * p->y)));
 	*p *= a;
 }
 );
 
-std::string strF = KERNEL_R_STRING(
-void F(float2* p, float3* c, local uint* variations, local float* colours, local float* weightThresholds,
-	float weightTotal, uint numVariations, uint* seed)
+std::string strSelectedVariation = createSelectedVariationSource(specialisedBlends, fastVariations);
+
+std::string strSelection = KERNEL_R_STRING(
+void copySelectionTables(global float* weights, global float* aliasProbabilities, global uint* aliasIndices, uint numVariations,
+	local float* lc_weightThresholds, local float* lc_aliasProbabilities, local uint* lc_aliasIndices)
+{
+	float weightTotal = 0;
+	for (uint j = 0; j < numVariations; j++)
+	{
+		weightTotal += weights[j];
+		lc_weightThresholds[j] = weightTotal;
+
+		lc_aliasProbabilities[j] = aliasProbabilities[j];
+		lc_aliasIndices[j] = aliasIndices[j];
+	}
+}
+
+uint selectVariation(local float* weightThresholds, float weightTotal, local float* aliasProbabilities, local uint* aliasIndices,
+	uint numVariations, uint selectionMode, float u)
 {
-	//pick a weighted-random variation to apply
+	//pick a weighted-random variation index, using the uniform number u in [0, 1]
+
+	if (selectionMode == SELECTION_ALIAS)
+	{
+		//pick a slot uniformly, then keep it or take its alias. the fractional part of the same number decides which
+		float slotU = u * numVariations;
+		uint slot = min((uint)slotU, numVariations - 1);
+		return (slotU - slot < aliasProbabilities[slot]) ? slot : aliasIndices[slot];
+	}
+
+	//all zero weights pick every entry equally, the same as the alias table
+	if (weightTotal <= 0.0f) return min((uint)(u * numVariations), numVariations - 1);
 
-	float weightedRandom = RNG(seed) * weightTotal;
+	float weightedRandom = u * weightTotal;
 	uint r = 0;
 	while (r < numVariations)
 	{
@@ -277,129 +831,911 @@ void F(float2* p, float3* c, local uint* variations, local float* colours, local
 		r++;
 	}
 
-	*c = 0.5f * (*c + (float3)(colours[r * 3 + 0], colours[r * 3 + 1], colours[r * 3 + 2]));
-
-	uint v = variations[r];
-	if (v == 0) return;
-	else if (v == 1) v1(p);
-	else if (v == 2) v2(p);
-	else if (v == 3) v3(p);
-	else if (v == 4) v4(p);
-	else if (v == 5) v5(p);
-	else if (v == 6) v6(p);
-	else if (v == 7) v7(p);
-	else if (v == 8) v8(p);
-	else if (v == 9) v9(p);
-	else if (v == 10) v10(p);
-	else if (v == 11) v11(p);
-	else if (v == 12) v12(p);
-	else if (v == 13) v13(p, seed);
-	else if (v == 14) v14(p);
-	else if (v == 18) v18(p);
-	else if (v == 19) v19(p);
-	else if (v == 20) v20(p);
-	else if (v == 28) v28(p);
-	else if (v == 29) v29(p);
-	else if (v == 42) v42(p);
-	else if (v == 48) v48(p);
+	//u == 1 runs off the end of the thresholds, which picks the last entry
+	return min(r, numVariations - 1);
 }
 );
 
-std::string strPlot = KERNEL_R_STRING(
-	void plot(global float* renderTexture, float2 p, float3 c, float16 matView, uint texWidth, uint texHeight)
+std::string strF = KERNEL_R_STRING(
+uint selectF(float3* c, local float* colours, local float* weightThresholds, float weightTotal, local float* aliasProbabilities,
+	local uint* aliasIndices, uint numVariations, uint selectionMode, float u)
 {
-	//draw the sample point to the buffer
+	//pick a weighted-random variation to apply, and blend its colour in
+	uint r = selectVariation(weightThresholds, weightTotal, aliasProbabilities, aliasIndices, numVariations, selectionMode, u);
 
-	//transform sample point to camera view
-	float4 pClip = mat4MulVec4(matView, (float4)(p.x, p.y, 0.0f, 1.0f));
+	*c = 0.5f * (*c + (float3)(colours[r * 3 + 0], colours[r * 3 + 1], colours[r * 3 + 2]));
 
-	float u = pClip.x * 0.5f + 0.5f;
-	float v = pClip.y * 0.5f + 0.5f;
+	return r;
+}
 
-	//discard positions outside of the buffer
-	int pixelX = u * texWidth;
-	int pixelY = v * texHeight;
-	if (pixelX < 0 || pixelX >= texWidth || pixelY < 0 || pixelY >= texHeight) return;
+uint F(float2* p, float* z, float3* c, local uint* variations, local float* blendWeights, local float* colours,
+	local float* weightThresholds, float weightTotal, local float* aliasProbabilities, local uint* aliasIndices, uint numVariations,
+	uint selectionMode, uint* seed, float u)
+{
+	//u picks the variation, seed is for any variation which uses random numbers. returns the index which was picked. z is
+	//the point's depth, which the variations' 3d forms read and move
+	uint r = selectF(c, colours, weightThresholds, weightTotal, aliasProbabilities, aliasIndices, numVariations, selectionMode, u);
+	applySelectedVariation(r, variations, blendWeights, p, z, seed);
+	return r;
+}
 
-	//draw to buffer by accumulating pixel values
-	uint pixelIndex = pixelY * texWidth + pixelX;
-	atomicAddFloat(&renderTexture[pixelIndex * 4 + 0], c.x);
-	atomicAddFloat(&renderTexture[pixelIndex * 4 + 1], c.y);
-	atomicAddFloat(&renderTexture[pixelIndex * 4 + 2], c.z);
-	atomicAddFloat(&renderTexture[pixelIndex * 4 + 3], 1.0f);
+uint affineF(float2* p, float* z, float3* c, local float* affineMaps, local float* colours, local float* weightThresholds,
+	float weightTotal, local float* aliasProbabilities, local uint* aliasIndices, uint numVariations, uint selectionMode, float u,
+	uint dimensions)
+{
+	//F for the affine transform mode, the chosen entry's 3x4 map instead of its variation. 2d points keep z at 0
+	uint r = selectF(c, colours, weightThresholds, weightTotal, aliasProbabilities, aliasIndices, numVariations, selectionMode, u);
+	local float* m = &affineMaps[r * AFFINE_MAP_SIZE];
+	float3 q = (float3)(*p, *z);
+	*p = (float2)(fma(m[0], q.x, fma(m[1], q.y, fma(m[2], q.z, m[3]))), fma(m[4], q.x, fma(m[5], q.y, fma(m[6], q.z, m[7]))));
+	if (dimensions == DIMENSIONS_3D) *z = fma(m[8], q.x, fma(m[9], q.y, fma(m[10], q.z, m[11])));
+	return r;
 }
-);
 
-std::string strProduceSamples = KERNEL_R_STRING(
+uint regroupedF(float2* p, float* z, float3* c, bool active, local uint* variations, local float* blendWeights, local float* colours,
+	local float* weightThresholds, float weightTotal, local float* aliasProbabilities, local uint* aliasIndices, uint numVariations,
+	uint selectionMode, uint* seed, float u, local float2* lc_regroupPoints, local uint* lc_regroupIndices, local uint* lc_queues)
+{
+	//same result as F, but the work group's points are put into a queue for each variation between choosing a variation
+	//and applying it. neighbouring work items then run the same variation function instead of each taking a different
+	//branch. every work item of the group has to call this, active or not
+
+	const uint lid = get_local_id(0);
+	local uint* queueCounts = lc_queues;
+	local uint* queueOffsets = &lc_queues[MAX_VARIATIONS];
+
+	for (uint q = lid; q < MAX_VARIATIONS; q += get_local_size(0))
+	{
+		queueCounts[q] = 0;
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	//select phase, each point takes the next place in its variation's queue
+	uint r = 0;
+	uint rank = 0;
+	if (active)
+	{
+		r = selectF(c, colours, weightThresholds, weightTotal, aliasProbabilities, aliasIndices, numVariations, selectionMode, u);
+		rank = atomic_inc(&queueCounts[r]);
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	//prefix sum of the queue sizes gives where each queue starts, the last offset is the number of active points
+	if (lid == 0)
+	{
+		uint total = 0;
+		for (uint q = 0; q < numVariations; q++)
+		{
+			queueOffsets[q] = total;
+			total += queueCounts[q];
+		}
+		queueOffsets[numVariations] = total;
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	//the seed and depth move with the point, so the result is the same whichever work item applies the variation
+	uint slot = queueOffsets[r] + rank;
+	if (active)
+	{
+		lc_regroupPoints[slot] = *p;
+		lc_regroupIndices[slot * 3 + 0] = r;
+		lc_regroupIndices[slot * 3 + 1] = *seed;
+		lc_regroupIndices[slot * 3 + 2] = as_uint(*z);
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	//evaluate phase, work items take the points in queue order
+	if (lid < queueOffsets[numVariations])
+	{
+		float2 q = lc_regroupPoints[lid];
+		uint qSeed = lc_regroupIndices[lid * 3 + 1];
+		float qZ = as_float(lc_regroupIndices[lid * 3 + 2]);
+		applySelectedVariation(lc_regroupIndices[lid * 3 + 0], variations, blendWeights, &q, &qZ, &qSeed);
+		lc_regroupPoints[lid] = q;
+		lc_regroupIndices[lid * 3 + 1] = qSeed;
+		lc_regroupIndices[lid * 3 + 2] = as_uint(qZ);
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (active)
+	{
+		*p = lc_regroupPoints[slot];
+		*seed = lc_regroupIndices[slot * 3 + 1];
+		*z = as_float(lc_regroupIndices[slot * 3 + 2]);
+	}
+
+	//the next call doesn't write lc_regroupPoints until after two more barriers, so no barrier needed here
+	return r;
+}
+
+bool nonFinite(float2 p)
+{
+	//test the exponent bits for inf and nan, since -cl-finite-math-only lets the compiler assume isinf and isnan are false
+	uint2 exponent = as_uint2(p) & 0x7F800000u;
+	return any(exponent == (uint2)(0x7F800000u));
+}
+
+bool escaped(float2 p)
+{
+	return nonFinite(p) || dot(p, p) > ESCAPE_RADIUS * ESCAPE_RADIUS;
+}
+
+void respawn(float2* p, float3* c, local uint* variations, local float* blendWeights, local float* colours,
+	local float* weightThresholds, float weightTotal, local float* aliasProbabilities, local uint* aliasIndices, uint numVariations,
+	uint selectionMode, uint* seed, local uint* lc_statistics, uint transformMode, local float* affineMaps, float* z, uint dimensions,
+	local float* depths, uint* history)
+{
+	//replace an escaped point with a new random one, and run a few iterations so it starts near the attractor. the point's
+	//own seed carries on being used, so this doesn't need the rest of the work group
+	*p = (float2)(RNG(seed) * 2.0f - 1.0f, RNG(seed) * 2.0f - 1.0f);
+	*c = (float3)(RNG(seed), RNG(seed), RNG(seed));
+	//2d points go back to a depth of 0, in case the escape left z as nan
+	*z = dimensions == DIMENSIONS_3D ? RNG(seed) * 2.0f - 1.0f : 0.0f;
+
+	for (uint j = 0; j < RESPAWN_ITERATIONS; j++)
+	{
+		uint r;
+		if (transformMode == TRANSFORM_AFFINE)
+		{
+			r = affineF(p, z, c, affineMaps, colours, weightThresholds, weightTotal, aliasProbabilities, aliasIndices,
+				numVariations, selectionMode, RNG(seed), dimensions);
+		}
+		else
+		{
+			r = F(p, z, c, variations, blendWeights, colours, weightThresholds, weightTotal, aliasProbabilities, aliasIndices,
+				numVariations, selectionMode, seed, RNG(seed));
+			if (dimensions == DIMENSIONS_3D) *z = 0.5f * (*z + depths[r]);
+		}
+
+		*history = (*history << ENTRY_HISTORY_BITS) | r;
+	}
+
+	atomic_inc(&lc_statistics[STAT_RESPAWNS]);
+}
+
+void iterate(float2* p, float3* c, bool active, uint executionMode, local uint* variations, local float* blendWeights,
+	local float* colours, local float* weightThresholds, float weightTotal, local float* aliasProbabilities, local uint* aliasIndices,
+	uint numVariations, uint selectionMode, uint* seed, uint choiceMode, uint* sharedSeed, uint samplerMode, uint pointIndex,
+	uint numPoints, uint choiceRotation, local float2* lc_regroupPoints, local uint* lc_regroupIndices, local uint* lc_queues,
+	local uint* lc_statistics, uint transformMode, local float* affineMaps, uchar countStatistics, float* z, uint dimensions,
+	local float* depths, uint* history)
+{
+	//one iteration of F for this work item's point, in either execution mode
+
+	//the number which picks the variation. with a shared choice every work item in the group has an identical sharedSeed,
+	//so they all pick the same variation without needing to communicate. the low discrepancy sampler spreads the choices
+	//of all the points evenly each iteration
+	float u;
+	if (choiceMode == CHOICE_SHARED) u = RNG(sharedSeed);
+	else if (samplerMode == SAMPLER_LOW_DISCREPANCY) u = stratifiedUniform(pointIndex, numPoints, choiceRotation);
+	else u = RNG(seed);
+
+	uint r = 0;
+	if (transformMode == TRANSFORM_AFFINE)
+	{
+		//every map takes the same instructions, so there is nothing for regrouping to gain
+		if (active)
+		{
+			r = affineF(p, z, c, affineMaps, colours, weightThresholds, weightTotal, aliasProbabilities, aliasIndices,
+				numVariations, selectionMode, u, dimensions);
+		}
+	}
+	else if (executionMode == EXECUTION_REGROUPED)
+	{
+		r = regroupedF(p, z, c, active, variations, blendWeights, colours, weightThresholds, weightTotal, aliasProbabilities, aliasIndices,
+			numVariations, selectionMode, seed, u, lc_regroupPoints, lc_regroupIndices, lc_queues);
+	}
+	else if (active)
+	{
+		r = F(p, z, c, variations, blendWeights, colours, weightThresholds, weightTotal, aliasProbabilities, aliasIndices, numVariations,
+			selectionMode, seed, u);
+	}
+
+	if (active && countStatistics)
+	{
+		atomic_inc(&lc_statistics[STAT_SELECTIONS + r]);
+	}
+
+	//most variations carry z through unchanged, so the depth is also pulled halfway to the chosen entry's, the same way the
+	//colour is. affine maps move z themselves
+	if (active && dimensions == DIMENSIONS_3D && transformMode == TRANSFORM_VARIATIONS)
+	{
+		*z = 0.5f * (*z + depths[r]);
+	}
+
+	//remembered for per-entry colour, which blends the entries' colours when the histogram is drawn instead
+	if (active) *history = (*history << ENTRY_HISTORY_BITS) | r;
+
+	//points which have escaped to infinity would spend the rest of their iterations off screen
+	if (active && escaped(*p))
+	{
+		if (countStatistics && nonFinite(*p)) atomic_inc(&lc_statistics[STAT_NON_FINITE]);
+		respawn(p, c, variations, blendWeights, colours, weightThresholds, weightTotal, aliasProbabilities, aliasIndices,
+			numVariations, selectionMode, seed, lc_statistics, transformMode, affineMaps, z, dimensions, depths, history);
+	}
+}
+);
+
+std::string strApplyVariation = KERNEL_R_STRING(
+void applyVariation(uint v, float2* p, Polar q, uint* seed)
+{
+	if (v == 0) return;
+	else if (v == 1) v1(p, q);
+	else if (v == 2) v2(p, q);
+	else if (v == 3) v3(p, q);
+	else if (v == 4) v4(p, q);
+	else if (v == 5) v5(p, q);
+	else if (v == 6) v6(p, q);
+	else if (v == 7) v7(p, q);
+	else if (v == 8) v8(p, q);
+	else if (v == 9) v9(p, q);
+	else if (v == 10) v10(p, q);
+	else if (v == 11) v11(p, q);
+	else if (v == 12) v12(p, q);
+	else if (v == 13) v13(p, q, seed);
+	else if (v == 14) v14(p, q);
+	else if (v == 18) v18(p, q);
+	else if (v == 19) v19(p, q);
+	else if (v == 20) v20(p, q);
+	else if (v == 28) v28(p, q);
+	else if (v == 29) v29(p, q);
+	else if (v == 42) v42(p, q);
+	else if (v == 48) v48(p, q);
+}
+
+void applyBlend(uint r, local uint* variations, local float* blendWeights, float2* p, float* z, uint* seed)
+{
+	//entry r's weighted sum of its variations, which all start from the same point and share one set of polar
+	//coordinates. slots with no weight are skipped
+	local uint* v = &variations[r * MAX_BLEND_VARIATIONS];
+	local float* w = &blendWeights[r * MAX_BLEND_VARIATIONS];
+
+	bool withAngle = false;
+	for (uint b = 0; b < MAX_BLEND_VARIATIONS; b++)
+	{
+		if (w[b] != 0.0f) withAngle |= usesAngle(v[b]);
+	}
+
+	Polar q = polarCoordinates(*p, *z, withAngle);
+	float2 sum = (float2)(0.0f);
+	float sumZ = 0.0f;
+	for (uint b = 0; b < MAX_BLEND_VARIATIONS; b++)
+	{
+		if (w[b] == 0.0f) continue;
+
+		float2 vp = *p;
+		applyVariation(v[b], &vp, q, seed);
+		sum += w[b] * vp;
+		sumZ += w[b] * variationZ(v[b], q);
+	}
+
+	*p = sum;
+	*z = sumZ;
+}
+);
+
+std::string strFastVariations = createFastVariationSource(strVariations);
+std::string strApplyVariationFast = std::regex_replace(strApplyVariation, std::regex("\\bapplyVariation\\("), "applyVariationFast(");
+strApplyVariationFast = std::regex_replace(strApplyVariationFast, std::regex("\\bapplyBlend\\("), "applyBlendFast(");
+strApplyVariationFast = std::regex_replace(strApplyVariationFast, std::regex("\\bpolarCoordinates\\("), "polarCoordinates_fast(");
+strApplyVariationFast = std::regex_replace(strApplyVariationFast, std::regex("\\bv([0-9]+)\\("), "v$1_fast(");
+
+std::string strCompareVariations = KERNEL_R_STRING(
+kernel void compareVariations(global float* errors, uint variation, uint gridSize, float gridExtent)
+{
+	//error of the fast version of a variation against the precise one, over a grid of points covering
+	//[-gridExtent, gridExtent]. the error is relative for results further than 1 from the origin and absolute otherwise.
+	//points where the precise result is inf or nan are marked -1 to be skipped, and fast results which are inf or nan
+	//where the precise one isn't count as the largest error
+	uint i = get_global_id(0);
+	if (i >= gridSize * gridSize) return;
+
+	float2 p = (convert_float2((uint2)(i % gridSize, i / gridSize)) + 0.5f) / (float)gridSize * 2.0f * gridExtent - gridExtent;
+	float2 precise = p;
+	float2 fast = p;
+	uint preciseSeed = i;
+	uint fastSeed = i;
+	applyVariation(variation, &precise, polarCoordinates(p, 0.0f, true), &preciseSeed);
+	applyVariationFast(variation, &fast, polarCoordinates_fast(p, 0.0f, true), &fastSeed);
+
+	if (nonFinite(precise)) errors[i] = -1.0f;
+	else if (nonFinite(fast)) errors[i] = MAXFLOAT;
+	else errors[i] = length(fast - precise) / max(length(precise), 1.0f);
+}
+);
+
+std::string strPlot = KERNEL_R_STRING(
+uint packColour(float3 c)
+{
+	//10 bits per channel, for deferred records
+	uint3 cPacked = convert_uint3_rte(clamp(c, 0.0f, 1.0f) * 1023.0f);
+	return cPacked.x | (cPacked.y << 10) | (cPacked.z << 20);
+}
+
+float3 unpackColour(uint c)
+{
+	return convert_float3((uint3)(c & 1023u, (c >> 10) & 1023u, (c >> 20) & 1023u)) / 1023.0f;
+}
+
+float tentCDF(float t, float w)
+{
+	//fraction of a tent filter with radius w which lies below t
+	if (t <= -w) return 0.0f;
+	if (t >= w) return 1.0f;
+
+	float f = (w - fabs(t)) * (w - fabs(t)) / (2.0f * w * w);
+	return t < 0.0f ? f : 1.0f - f;
+}
+
+void splatTent(global float* renderTexture, float2 pixelPos, float3 c, float splatWidth, uint texWidth, uint texHeight,
+	uint pixelOffset, uint histogramLayout)
+{
+	//add the sample to every pixel under the tent filter, weighted by how much of the filter covers it. float accumulation
+	//only, as the counts are fractional
+	int x0 = floor(pixelPos.x - splatWidth);
+	int x1 = floor(pixelPos.x + splatWidth);
+	int y0 = floor(pixelPos.y - splatWidth);
+	int y1 = floor(pixelPos.y + splatWidth);
+
+	for (int y = max(y0, 0); y <= min(y1, (int)texHeight - 1); y++)
+	{
+		float wy = tentCDF(y + 1 - pixelPos.y, splatWidth) - tentCDF(y - pixelPos.y, splatWidth);
+
+		for (int x = max(x0, 0); x <= min(x1, (int)texWidth - 1); x++)
+		{
+			float w = wy * (tentCDF(x + 1 - pixelPos.x, splatWidth) - tentCDF(x - pixelPos.x, splatWidth));
+			if (w <= 0.0f) continue;
+
+			uint pixelIndex = pixelOffset + histogramIndex(x, y, texWidth, histogramLayout);
+			atomicAddFloat(&renderTexture[pixelIndex * 4 + 0], c.x * w);
+			atomicAddFloat(&renderTexture[pixelIndex * 4 + 1], c.y * w);
+			atomicAddFloat(&renderTexture[pixelIndex * 4 + 2], c.z * w);
+			atomicAddFloat(&renderTexture[pixelIndex * 4 + 3], w);
+		}
+	}
+}
+
+float2 applyCameraOffset(float2 p, float4 cameraOffset, uint cameraMode)
+{
+	//move the point so the camera is at the origin, before the view matrix scales it. the camera position is a
+	//double-float, high parts in xy and the remainders in zw
+	if (cameraMode == CAMERA_FP64)
+	{
+)+"#ifdef cl_khr_fp64"+KERNEL_R_STRING(
+		return convert_float2(convert_double2(p) - (convert_double2(cameraOffset.xy) + convert_double2(cameraOffset.zw)));
+)+"#endif"+KERNEL_R_STRING(
+	}
+
+	//points near the camera are close to the high part, so that difference is exact
+	return (p - cameraOffset.xy) - cameraOffset.zw;
+}
+
+bool plot(global float* renderTexture, float3 p, float3 c, float16 matView, uint texWidth, uint texHeight, uint pixelOffset,
+	uint accumulationMode, uint binningMode, local uint* lc_cacheTags, local uint* lc_cacheValues,
+	global uint2* deferredRecords, uint recordIndex, float splatWidth, uint histogramLayout, uint cameraMode,
+	float4 cameraOffset, float fogDensity, uint history, uint numChannels)
+{
+	//draw the sample point to the buffer. returns false if it was outside of the view. 2d points have a depth of 0. with
+	//per-entry colour or the palette format, history is the point's recent choices and c is unused, so fog doesn't apply
+
+	if (cameraMode != CAMERA_SINGLE)
+	{
+		p.xy = applyCameraOffset(p.xy, cameraOffset, cameraMode);
+	}
+
+	//transform sample point to camera view
+	float4 pClip = mat4MulVec4(matView, (float4)(p, 1.0f));
+
+	//cull points behind the camera, past the near or far planes, or further outside the sides than a splat can reach. the
+	//2d view matrix is orthographic with w = 1 and gives depth 0 a z of 0, so only the sides apply there
+	float2 margin = 1.0f + 2.0f * splatWidth / convert_float2((uint2)(texWidth, texHeight));
+	if (pClip.w <= 0.0f || fabs(pClip.z) > pClip.w || any(fabs(pClip.xy) > pClip.w * margin))
+	{
+		if (binningMode == BINNING_DEFERRED) deferredRecords[recordIndex] = (uint2)(DEFERRED_EMPTY_RECORD, 0);
+		return false;
+	}
+
+	//perspective divide, then fade the colour with distance from the camera, which is w for a perspective camera
+	pClip.xy /= pClip.w;
+	if (fogDensity > 0.0f) c *= exp(-fogDensity * pClip.w);
+
+	//the palette format plots the point's palette coordinate instead of its colour, which fog doesn't apply to
+	if (accumulationMode == ACCUMULATION_PALETTE) c = (float3)(paletteCoordinate(history, numChannels), 0.0f, 0.0f);
+
+	float u = pClip.x * 0.5f + 0.5f;
+	float v = pClip.y * 0.5f + 0.5f;
+
+	if (splatWidth > 0.0f)
+	{
+		float2 pixelPos = (float2)(u * texWidth, v * texHeight);
+		if (accumulationMode == ACCUMULATION_FLOAT && binningMode == BINNING_DIRECT)
+		{
+			splatTent(renderTexture, pixelPos, c, splatWidth, texWidth, texHeight, pixelOffset, histogramLayout);
+			return pixelPos.x >= 0.0f && pixelPos.x < texWidth && pixelPos.y >= 0.0f && pixelPos.y < texHeight;
+		}
+
+		//integer counts, the local cache and deferred records all take whole samples, so move the sample by a random
+		//offset from the tent filter instead. it lands in each covered pixel with the same weight as above on average, but
+		//adds noise that the real splat doesn't
+		uint splatSeed = hashUint(as_uint(pixelPos.x) ^ hashUint(as_uint(pixelPos.y) ^ recordIndex));
+		u += (RNG(&splatSeed) + RNG(&splatSeed) - 1.0f) * splatWidth / texWidth;
+		v += (RNG(&splatSeed) + RNG(&splatSeed) - 1.0f) * splatWidth / texHeight;
+	}
+
+	//discard positions outside of the buffer
+	int pixelX = u * texWidth;
+	int pixelY = v * texHeight;
+	bool inBounds = pixelX >= 0 && pixelX < texWidth && pixelY >= 0 && pixelY < texHeight;
+	//views after the first are stored after it in renderTexture
+	uint pixelIndex = pixelOffset + histogramIndex(pixelX, pixelY, texWidth, histogramLayout);
+
+	if (binningMode == BINNING_DEFERRED)
+	{
+		//every iteration has a record, so discarded positions leave an empty one
+		deferredRecords[recordIndex] = (uint2)(inBounds ? pixelIndex : DEFERRED_EMPTY_RECORD, packColour(c));
+		return inBounds;
+	}
+
+	if (!inBounds) return false;
+
+	//draw to buffer by accumulating pixel values. per-entry channels don't fit in the local cache's slots, so always go
+	//straight to the histogram
+	if (accumulationMode == ACCUMULATION_ENTRY_CHANNELS)
+	{
+		accumulateEntries(renderTexture, pixelIndex, history, numChannels);
+	}
+	else if (binningMode == BINNING_LOCAL_CACHE)
+	{
+		accumulateLocalCache(renderTexture, pixelIndex, c, accumulationMode, lc_cacheTags, lc_cacheValues);
+	}
+	else
+	{
+		accumulate(renderTexture, pixelIndex, c, accumulationMode);
+	}
+
+	return true;
+}
+);
+
+std::string strPlotViews = KERNEL_R_STRING(
+uint plotSymmetric(global float* renderTexture, float3 p, float3 c, float16 matView, uint texWidth, uint texHeight,
+	uint pixelOffset, uint accumulationMode, uint binningMode, local uint* lc_cacheTags, local uint* lc_cacheValues,
+	global uint2* deferredRecords, uint recordIndex, uint symmetryOrder, uchar symmetryMirror, float2 symmetryRotation,
+	float splatWidth, uint histogramLayout, uint cameraMode, float4 cameraOffset, float fogDensity, uint history, uint numChannels)
+{
+	//plot each symmetric copy of the point. copies are rotated about the origin (the z axis in 3d) by multiples of
+	//2pi / symmetryOrder, and each is also mirrored in the y axis if symmetryMirror is set. the copies' records follow on
+	//from recordIndex. returns how many copies were outside of the view
+
+	float3 q = p;
+	uint copy = 0;
+	uint offScreen = 0;
+	for (uint s = 0; s < symmetryOrder; s++)
+	{
+		offScreen += !plot(renderTexture, q, c, matView, texWidth, texHeight, pixelOffset, accumulationMode, binningMode,
+			lc_cacheTags, lc_cacheValues, deferredRecords, recordIndex + copy++, splatWidth, histogramLayout,
+			cameraMode, cameraOffset, fogDensity, history, numChannels);
+
+		if (symmetryMirror)
+		{
+			offScreen += !plot(renderTexture, (float3)(-q.x, q.y, q.z), c, matView, texWidth, texHeight, pixelOffset, accumulationMode,
+				binningMode, lc_cacheTags, lc_cacheValues, deferredRecords, recordIndex + copy++, splatWidth, histogramLayout,
+				cameraMode, cameraOffset, fogDensity, history, numChannels);
+		}
+
+		q.xy = (float2)(q.x * symmetryRotation.x - q.y * symmetryRotation.y, q.x * symmetryRotation.y + q.y * symmetryRotation.x);
+	}
+
+	return offScreen;
+}
+
+uint plotViews(global float* renderTexture, float3 p, float3 c, float16 matView, uint texWidth, uint texHeight,
+	uint accumulationMode, uint binningMode, local uint* lc_cacheTags, local uint* lc_cacheValues, global uint2* deferredRecords,
+	uint recordIndex, uint symmetryOrder, uchar symmetryMirror, float2 symmetryRotation, uint numExtraViews,
+	global float16* extraViewMatrices, global uint4* extraViewRects, float splatWidth, uint histogramLayout, uint cameraMode,
+	float4 cameraOffset, float fogDensity, uint history, uint numChannels)
+{
+	//plot the point into the main view, then into each extra view. extraViewRects holds (width, height, pixel offset, unused)
+	//for each extra view, so every view has its own part of renderTexture. each view's records follow on from the last's.
+	//outside of CAMERA_SINGLE the main camera's position is taken off first, so the extra views' matrices are relative to it.
+	//returns how many copies were outside of their view
+
+	const uint symmetryCopies = symmetryOrder * (symmetryMirror ? 2 : 1);
+
+	uint offScreen = plotSymmetric(renderTexture, p, c, matView, texWidth, texHeight, 0, accumulationMode, binningMode,
+		lc_cacheTags, lc_cacheValues, deferredRecords, recordIndex, symmetryOrder, symmetryMirror, symmetryRotation, splatWidth,
+		histogramLayout, cameraMode, cameraOffset, fogDensity, history, numChannels);
+
+	for (uint v = 0; v < numExtraViews; v++)
+	{
+		uint4 rect = extraViewRects[v];
+		offScreen += plotSymmetric(renderTexture, p, c, extraViewMatrices[v], rect.x, rect.y, rect.z, accumulationMode, binningMode,
+			lc_cacheTags, lc_cacheValues, deferredRecords, recordIndex + (v + 1) * symmetryCopies, symmetryOrder, symmetryMirror,
+			symmetryRotation, splatWidth, histogramLayout, cameraMode, cameraOffset, fogDensity, history, numChannels);
+	}
+
+	return offScreen;
+}
+);
+
+std::string strProduceSamples = KERNEL_R_STRING(
 kernel void produceSamples(global float* renderTexture, global uint* variations, global float* colours, global float* weights,
 	uint numVariations, uint initialIterations, uint iterations, float16 matView, uint texWidth, uint texHeight, uint frameNum,
-	uint numSamples, local uint* lc_variations, local float* lc_colours, local float* lc_weightThresholds)
+	uint numSamples, local uint* lc_variations, local float* lc_colours, local float* lc_weightThresholds, uint accumulationMode,
+	global float* pointStates, uchar resetPoints, uint binningMode, local uint* lc_cacheTags, local uint* lc_cacheValues,
+	global float* aliasProbabilities, global uint* aliasIndices, local float* lc_aliasProbabilities, local uint* lc_aliasIndices,
+	uint selectionMode, global uint2* deferredRecords, uint executionMode, local float2* lc_regroupPoints,
+	local uint* lc_regroupIndices, local uint* lc_queues, uint choiceMode, global uint* statistics, local uint* lc_statistics,
+	uint samplerMode, uint symmetryOrder, uchar symmetryMirror, uint numExtraViews, global float16* extraViewMatrices,
+	global uint4* extraViewRects, float splatWidth, uint histogramLayout, uint cameraMode, float4 cameraOffset, uint transformMode,
+	global float* affineMaps, local float* lc_affineMaps, uchar countStatistics, uint dimensions, global float* depths,
+	local float* lc_depths, float fogDensity, global uint* blendVariations, global float* blendWeights, local float* lc_blendWeights)
 {
-	//each thread describes one sample point which gets iterated on and drawn to renderTexture
+	//each thread describes CHAINS_PER_ITEM sample points which get iterated on and drawn to renderTexture. the points are
+	//saved to pointStates at the end, so the next launch can continue iterating them without needing the initial iterations again
 
 	const uint i = get_global_id(0);
-	if (i >= numSamples) return;
 
 	//buffers used frequently, so copy to local memory to reduce global reads
-	float weightTotal = 0;
 	if (get_local_id(0) == 0)
 	{
 		for (uint j = 0; j < numVariations; j++)
 		{
-			lc_variations[j] = variations[j];
+			//slot 0 of each blend is the entry's own variation
+			lc_variations[j * MAX_BLEND_VARIATIONS] = variations[j];
+			lc_blendWeights[j * MAX_BLEND_VARIATIONS] = blendWeights[j * MAX_BLEND_VARIATIONS];
+			for (uint b = 1; b < MAX_BLEND_VARIATIONS; b++)
+			{
+				lc_variations[j * MAX_BLEND_VARIATIONS + b] = blendVariations[j * MAX_BLEND_VARIATIONS + b];
+				lc_blendWeights[j * MAX_BLEND_VARIATIONS + b] = blendWeights[j * MAX_BLEND_VARIATIONS + b];
+			}
 
 			lc_colours[j * 3 + 0] = colours[j * 3 + 0];
 			lc_colours[j * 3 + 1] = colours[j * 3 + 1];
 			lc_colours[j * 3 + 2] = colours[j * 3 + 2];
-			
-			weightTotal += weights[j];
-			lc_weightThresholds[j] = weightTotal;
+
+			lc_depths[j] = depths[j];
+		}
+
+		copySelectionTables(weights, aliasProbabilities, aliasIndices, numVariations, lc_weightThresholds, lc_aliasProbabilities,
+			lc_aliasIndices);
+	}
+
+	if (transformMode == TRANSFORM_AFFINE)
+	{
+		for (uint j = get_local_id(0); j < numVariations * AFFINE_MAP_SIZE; j += get_local_size(0))
+		{
+			lc_affineMaps[j] = affineMaps[j];
 		}
 	}
 
-	weightTotal = lc_weightThresholds[numVariations - 1];
+	for (uint j = get_local_id(0); j < NUM_STATS; j += get_local_size(0))
+	{
+		lc_statistics[j] = 0;
+	}
+
+	if (binningMode == BINNING_LOCAL_CACHE)
+	{
+		clearLocalCache(lc_cacheTags, lc_cacheValues);
+	}
 
 	barrier(CLK_GLOBAL_MEM_FENCE | CLK_LOCAL_MEM_FENCE);
 
-	uint seed = i + frameNum * numSamples;
-	RNG(&seed); //randomise the seed once before using
+	const float weightTotal = lc_weightThresholds[numVariations - 1];
 
-	float2 p = (float2)(RNG(&seed) * 2.0f - 1.0f, RNG(&seed) * 2.0f - 1.0f);
-	float3 c = (float3)(RNG(&seed), RNG(&seed), RNG(&seed));
+	//each work item runs CHAINS_PER_ITEM sample points side by side, so the independent work of one can fill the gaps while
+	//another waits on a slow maths function
+	float2 p[CHAINS_PER_ITEM];
+	float z[CHAINS_PER_ITEM];
+	float3 c[CHAINS_PER_ITEM];
+	uint seed[CHAINS_PER_ITEM];
+	uint history[CHAINS_PER_ITEM];
+	bool active[CHAINS_PER_ITEM];
 
-	//do some initial iterations to move away from unifom distribution in unit square
-	for (uint j = 0; j < initialIterations; j++)
+	for (uint k = 0; k < CHAINS_PER_ITEM; k++)
 	{
-		F(&p, &c, lc_variations, lc_colours, lc_weightThresholds, weightTotal, numVariations, &seed);
+		const uint pointIndex = i * CHAINS_PER_ITEM + k;
+		global float* state = &pointStates[pointIndex * POINT_STATE_SIZE];
+
+		//points past the end of the samples still have to reach the barriers, they just don't get iterated
+		active[k] = pointIndex < numSamples;
+		p[k] = (float2)(0.0f);
+		z[k] = 0.0f;
+		c[k] = (float3)(0.0f);
+		seed[k] = 0;
+		history[k] = 0;
+
+		if (active[k] && resetPoints)
+		{
+			//index of this point over every launch, so each gets its own seed and start point
+			ulong streamIndex = (ulong)frameNum * numSamples + pointIndex;
+			seed[k] = streamSeed(streamIndex);
+
+			if (samplerMode == SAMPLER_LOW_DISCREPANCY)
+			{
+				p[k] = r2Point(streamIndex) * 2.0f - 1.0f;
+			}
+			else
+			{
+				p[k] = (float2)(RNG(&seed[k]) * 2.0f - 1.0f, RNG(&seed[k]) * 2.0f - 1.0f);
+			}
+			c[k] = (float3)(RNG(&seed[k]), RNG(&seed[k]), RNG(&seed[k]));
+			if (dimensions == DIMENSIONS_3D) z[k] = RNG(&seed[k]) * 2.0f - 1.0f;
+		}
+		else if (active[k])
+		{
+			//continue from where the point was left by the previous launch
+			p[k] = vload2(0, state);
+			c[k] = vload3(0, state + 2);
+			seed[k] = as_uint(state[5]);
+			z[k] = state[6];
+			history[k] = as_uint(state[7]);
+		}
 	}
-	
+
+	//the stream of shared variation choices for this work group, which continues with the frame number between launches
+	uint sharedSeed = get_group_id(0) + frameNum * get_num_groups(0);
+	RNG(&sharedSeed);
+
+	//each plotted point is drawn once for every symmetric copy in every view
+	const uint plotCopies = symmetryOrder * (symmetryMirror ? 2 : 1) * (numExtraViews + 1);
+	const float2 symmetryRotation = (float2)(cos(2.0f * PI / symmetryOrder), sin(2.0f * PI / symmetryOrder));
+
+	//rotations for the stratified variation choices, the same for every work item
+	uint rotationSeed = hashUint(frameNum);
+
+	//loops are the same length for every work item, as the regrouped execution mode has barriers in each iteration
+	if (resetPoints)
+	{
+		//do some initial iterations to move away from unifom distribution in unit square
+		for (uint j = 0; j < initialIterations; j++)
+		{
+			uint choiceRotation = hashUint(rotationSeed++);
+			for (uint k = 0; k < CHAINS_PER_ITEM; k++)
+			{
+				iterate(&p[k], &c[k], active[k], executionMode, lc_variations, lc_blendWeights, lc_colours, lc_weightThresholds, weightTotal,
+					lc_aliasProbabilities, lc_aliasIndices, numVariations, selectionMode, &seed[k], choiceMode, &sharedSeed,
+					samplerMode, i * CHAINS_PER_ITEM + k, numSamples, choiceRotation, lc_regroupPoints, lc_regroupIndices, lc_queues, lc_statistics,
+					transformMode, lc_affineMaps, countStatistics, &z[k], dimensions, lc_depths, &history[k]);
+			}
+		}
+	}
+
 	for (uint j = 0; j < iterations; j++)
 	{
-		//pick a random function
-		F(&p, &c, lc_variations, lc_colours, lc_weightThresholds, weightTotal, numVariations, &seed);
+		uint choiceRotation = hashUint(rotationSeed++);
+		for (uint k = 0; k < CHAINS_PER_ITEM; k++)
+		{
+			//pick a random function
+			iterate(&p[k], &c[k], active[k], executionMode, lc_variations, lc_blendWeights, lc_colours, lc_weightThresholds, weightTotal,
+				lc_aliasProbabilities, lc_aliasIndices, numVariations, selectionMode, &seed[k], choiceMode, &sharedSeed,
+				samplerMode, i * CHAINS_PER_ITEM + k, numSamples, choiceRotation, lc_regroupPoints, lc_regroupIndices, lc_queues, lc_statistics,
+				transformMode, lc_affineMaps, countStatistics, &z[k], dimensions, lc_depths, &history[k]);
+		}
+
+		for (uint k = 0; k < CHAINS_PER_ITEM; k++)
+		{
+			//plot the result
+			if (active[k])
+			{
+				uint offScreen = plotViews(renderTexture, (float3)(p[k], z[k]), c[k], matView, texWidth, texHeight, accumulationMode, binningMode,
+					lc_cacheTags, lc_cacheValues, deferredRecords, ((i * CHAINS_PER_ITEM + k) * iterations + j) * plotCopies,
+					symmetryOrder, symmetryMirror, symmetryRotation, numExtraViews, extraViewMatrices, extraViewRects, splatWidth,
+					histogramLayout, cameraMode, cameraOffset, fogDensity, history[k], numVariations);
+				if (countStatistics && offScreen > 0) atomic_add(&lc_statistics[STAT_OFF_SCREEN], offScreen);
+			}
+		}
+	}
+
+	for (uint k = 0; k < CHAINS_PER_ITEM; k++)
+	{
+		if (!active[k]) continue;
+
+		const uint pointIndex = i * CHAINS_PER_ITEM + k;
+		global float* state = &pointStates[pointIndex * POINT_STATE_SIZE];
+
+		if (iterations == 0)
+		{
+			//if there weren't any iterations, still want to draw where the point was
+			uint offScreen = plotViews(renderTexture, (float3)(p[k], z[k]), c[k], matView, texWidth, texHeight, accumulationMode, binningMode,
+				lc_cacheTags, lc_cacheValues, deferredRecords, pointIndex * plotCopies, symmetryOrder, symmetryMirror,
+				symmetryRotation, numExtraViews, extraViewMatrices, extraViewRects, splatWidth, histogramLayout, cameraMode,
+				cameraOffset, fogDensity, history[k], numVariations);
+			if (countStatistics && offScreen > 0) atomic_add(&lc_statistics[STAT_OFF_SCREEN], offScreen);
+		}
+
+		vstore2(p[k], 0, state);
+		vstore3(c[k], 0, state + 2);
+		state[5] = as_float(seed[k]);
+		state[6] = z[k];
+		state[7] = as_float(history[k]);
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (binningMode == BINNING_LOCAL_CACHE)
+	{
+		//once the whole work group has plotted, write the cache out to the histogram
+		flushLocalCache(renderTexture, accumulationMode, lc_cacheTags, lc_cacheValues, lc_statistics);
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	//one global atomic per statistic for the whole work group
+	for (uint j = get_local_id(0); j < NUM_STATS; j += get_local_size(0))
+	{
+		if (lc_statistics[j] > 0) atomic_add(&statistics[j], lc_statistics[j]);
+	}
+}
+);
+
+std::string strDeepAccumulation = KERNEL_R_STRING(
+kernel void flushDeepAccumulation(global uint* chunkTexture, global ulong* deepTexture, uint numValues)
+{
+	//add a launch's fixed32 histogram to the 64 bit one, which is in the fixed64 format, and clear it for the next launch.
+	//one work item per value, so no atomics are needed
+	uint i = get_global_id(0);
+	if (i >= numValues) return;
+
+	ulong scale = i % 4 == 3 ? 1 : (ulong)(FIXED_POINT_SCALE_64 / FIXED_POINT_SCALE_32);
+	deepTexture[i] += chunkTexture[i] * scale;
+	chunkTexture[i] = 0;
+}
+);
+
+std::string strDeferredPlotting = KERNEL_R_STRING(
+kernel void countDeferredBuckets(global uint2* records, global uint* bucketCounts, uint numRecords)
+{
+	//count how many records land in each bucket of neighbouring pixels
+
+	uint i = get_global_id(0);
+	if (i >= numRecords) return;
+
+	uint pixelIndex = records[i].x;
+	if (pixelIndex == DEFERRED_EMPTY_RECORD) return;
+
+	atomic_inc(&bucketCounts[pixelIndex >> DEFERRED_BUCKET_BITS]);
+}
+
+kernel void scatterDeferredRecords(global uint2* records, global uint2* sortedRecords, global uint* bucketCursors, uint numRecords)
+{
+	//move each record into its bucket's range. bucketCursors starts as the offset of each bucket from the count prefix sum
+
+	uint i = get_global_id(0);
+	if (i >= numRecords) return;
+
+	uint2 record = records[i];
+	if (record.x == DEFERRED_EMPTY_RECORD) return;
+
+	uint sortedIndex = atomic_inc(&bucketCursors[record.x >> DEFERRED_BUCKET_BITS]);
+	sortedRecords[sortedIndex] = record;
+}
+
+kernel void reduceDeferredBuckets(global float* renderTexture, global uint2* sortedRecords, global uint* bucketOffsets,
+	uint numPixels, uint accumulationMode, local uint* lc_bucket)
+{
+	//one work group per bucket. the bucket's records are summed in local memory, then added to the histogram. no other
+	//group writes to these pixels so no global atomics are needed, and neighbouring work items write neighbouring pixels
+
+	const uint bucket = get_group_id(0);
+	const uint firstPixel = bucket << DEFERRED_BUCKET_BITS;
+
+	for (uint j = get_local_id(0); j < DEFERRED_BUCKET_PIXELS; j += get_local_size(0))
+	{
+		vstore8((uint8)(0), j, lc_bucket);
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (uint r = bucketOffsets[bucket] + get_local_id(0); r < bucketOffsets[bucket + 1]; r += get_local_size(0))
+	{
+		uint2 record = sortedRecords[r];
+		accumulateLocalSlot(&lc_bucket[(record.x - firstPixel) * 8], unpackColour(record.y), accumulationMode);
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (uint j = get_local_id(0); j < DEFERRED_BUCKET_PIXELS; j += get_local_size(0))
+	{
+		uint pixelIndex = firstPixel + j;
+		if (pixelIndex >= numPixels) break;
+
+		if (accumulationMode == ACCUMULATION_FIXED32)
+		{
+			global uint* tex = (global uint*)renderTexture;
+			uint4 sum = vload4(pixelIndex, tex) + vload4(0, &lc_bucket[j * 8]);
+			if (sum.w <= FIXED32_SATURATION_HITS) vstore4(sum, pixelIndex, tex);
+		}
+		else if (accumulationMode == ACCUMULATION_PACKED_RGB)
+		{
+			global uint* tex = (global uint*)renderTexture;
+			float4 sum = vload4(0, (local float*)&lc_bucket[j * 8]);
+			if (sum.w == 0.0f) continue;
+			uint seed = hashUint(pixelIndex ^ hashUint(tex[pixelIndex * 2 + 0] ^ as_uint(sum.x)));
+			tex[pixelIndex * 2 + 0] = packRGB9E5(unpackRGB9E5(tex[pixelIndex * 2 + 0]) + sum.xyz, seed);
+			tex[pixelIndex * 2 + 1] += (uint)sum.w;
+		}
+		else if (accumulationMode == ACCUMULATION_PALETTE)
+		{
+			global uint* tex = (global uint*)renderTexture;
+			if (tex[pixelIndex * 2 + 1] + lc_bucket[j * 8 + 3] > FIXED32_SATURATION_HITS) continue;
+			tex[pixelIndex * 2 + 0] += lc_bucket[j * 8 + 0];
+			tex[pixelIndex * 2 + 1] += lc_bucket[j * 8 + 3];
+		}
+		else if (accumulationMode == ACCUMULATION_FIXED64)
+		{
+			global ulong* tex = (global ulong*)renderTexture;
+			vstore4(vload4(pixelIndex, tex) + vload4(0, (local ulong*)&lc_bucket[j * 8]), pixelIndex, tex);
+		}
+		else
+		{
+			vstore4(vload4(pixelIndex, renderTexture) + vload4(0, (local float*)&lc_bucket[j * 8]), pixelIndex, renderTexture);
+		}
+	}
+}
+);
+
+std::string strBenchmarkSelection = KERNEL_R_STRING(
+kernel void benchmarkSelection(global uint* results, global float* weights, global float* aliasProbabilities,
+	global uint* aliasIndices, uint numVariations, uint iterations, uint selectionMode, uint numItems,
+	local float* lc_weightThresholds, local float* lc_aliasProbabilities, local uint* lc_aliasIndices)
+{
+	//only selects variations, so the difference between selection modes isn't hidden by the variation functions
 
-		//plot the result
-		plot(renderTexture, p, c, matView, texWidth, texHeight);
+	const uint i = get_global_id(0);
+
+	if (get_local_id(0) == 0)
+	{
+		copySelectionTables(weights, aliasProbabilities, aliasIndices, numVariations, lc_weightThresholds, lc_aliasProbabilities,
+			lc_aliasIndices);
 	}
 
-	if (iterations == 0)
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (i >= numItems) return;
+
+	const float weightTotal = lc_weightThresholds[numVariations - 1];
+	uint seed = i;
+	RNG(&seed);
+
+	uint total = 0;
+	for (uint j = 0; j < iterations; j++)
 	{
-		//if there weren't any iterations, still want to draw where the point was
-		plot(renderTexture, p, c, matView, texWidth, texHeight);
+		total += selectVariation(lc_weightThresholds, weightTotal, lc_aliasProbabilities, lc_aliasIndices, numVariations,
+			selectionMode, RNG(&seed));
 	}
+
+	//written out so the selections can't be optimised away
+	results[i] = total;
 }
 );
 
 std::string strRenderPostProcess = KERNEL_R_STRING(
-kernel void renderPostProcess(global float4* renderTexture, global uchar4* processedRenderTexture, float gamma,
-	float brightness, uchar renderTransparency, uint numPixels)
+kernel void renderPostProcess(global float* renderTexture, global uchar4* processedRenderTexture, float gamma,
+	float brightness, uchar renderTransparency, uint numPixels, uint accumulationMode, uint texWidth, uint histogramOffset,
+	uint outputOffset, uint histogramLayout, global float* colours, uint numChannels)
 {
-	//apply post processing (gamma, brightness, float -> byte). this is done in fragment shader for preview.
+	//apply post processing (gamma, brightness, float -> byte). this is done in fragment shader for preview. run once per
+	//view, reading the view's part of the histogram and writing row by row to its part of processedRenderTexture
 
 	uint i = get_global_id(0);
 	if (i >= numPixels) return;
 
-	float4 pix = renderTexture[i];
+	uint pixelIndex = histogramOffset + histogramIndex(i % texWidth, i / texWidth, texWidth, histogramLayout);
+	float4 pix = accumulationMode == ACCUMULATION_ENTRY_CHANNELS ?
+		readEntryChannels(renderTexture, pixelIndex, colours, numChannels) :
+		readAccumulation(renderTexture, pixelIndex, accumulationMode);
+
+	//the palette format is looked up from the mean coordinate of the pixel's samples
+	if (accumulationMode == ACCUMULATION_PALETTE && pix.w > 0.0f)
+	{
+		pix.xyz = paletteColour(colours, numChannels, pix.x / pix.w) * pix.w;
+	}
 
 	float alphaScale = log10(pix.w) / pix.w;
 	pix = brightness * alphaScale * pix;
@@ -413,20 +1749,34 @@ kernel void renderPostProcess(global float4* renderTexture, global uchar4* proce
 	pix = clamp(pix, 0.0f, 1.0f);
 	pix *= 255.0f;
 	uchar4 pixFinal = convert_uchar4(pix);
-	processedRenderTexture[i] = pixFinal;
+	processedRenderTexture[outputOffset + i] = pixFinal;
 }
 );
 
     std::string fullKernelSource =
 		strAtomicAddFloat +
-		strMat4MulVec4 +
+		strAtomicAddULong +
 		strRNG +
-		strSierpinskiTriangle +
-		strMengerSponge +
+		strSampler +
+		strAccumulation +
+		strLocalCache +
+		strMat4MulVec4 +
+		strFastMaths +
+		strPolar +
 		strVariations +
+		strFastVariations +
+		strApplyVariation +
+		strApplyVariationFast +
+		strSelectedVariation +
+		strSelection +
 		strF +
 		strPlot +
+		strPlotViews +
 		strProduceSamples +
+		strDeepAccumulation +
+		strDeferredPlotting +
+		strBenchmarkSelection +
+		strCompareVariations +
 		strRenderPostProcess;
 	
     return strPreProc + formatKernelString(fullKernelSource);
@@ -2,8 +2,16 @@
 #ifndef KERNELS_H
 #define KERNELS_H
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
-std::string createKernelSource();
+//marks a blend slot with no weight in specialisedBlends
+#define UNUSED_BLEND_SLOT 0xFFFFFFFFu
+
+//specialisedBlends can give the blend of variations at each index (MAX_BLEND_VARIATIONS slots each), to compile a
+//version of produceSamples for just that set. fastVariations makes produceSamples use the native_ maths versions of the
+//variations
+std::string createKernelSource(const std::vector<std::vector<uint32_t>>& specialisedBlends = {}, bool fastVariations = false);
 
 #endif
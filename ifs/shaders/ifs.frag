@@ -8,21 +8,121 @@ uniform uint texWidth, texHeight;
 uniform float gamma;
 uniform float brightness;
 
+//accumulation modes and fixed point scales from common_def.h
+uniform uint accumulationMode;
+uniform float fixedPointScale32;
+uniform float fixedPointScale64;
+const uint ACCUMULATION_FIXED32 = 1u;
+const uint ACCUMULATION_FIXED64 = 2u;
+const uint ACCUMULATION_ENTRY_CHANNELS = 3u;
+const float ENTRY_CHANNEL_SCALE = 256.0f;
+const uint ACCUMULATION_PACKED_RGB = 4u;
+const uint ACCUMULATION_PALETTE = 5u;
+const int PACKED_MANTISSA_BITS = 9;
+const int PACKED_EXPONENT_BIAS = 6;
+
+//per-entry colour has one channel per entry, which are given their colours here so they can change without resampling.
+//palette uses the same colours, interpolated in list order
+const uint MAX_VARIATIONS = 16u;
+uniform uint numEntries;
+uniform vec3 entryColours[MAX_VARIATIONS];
+
+//histogram layouts from common_def.h
+uniform uint histogramLayout;
+const uint LAYOUT_TILED = 1u;
+const uint HISTOGRAM_TILE_BITS = 3u;
+const uint HISTOGRAM_TILE_SIZE = 1u << HISTOGRAM_TILE_BITS;
+
 layout (std430) buffer TexOutput
 {
-    vec4 texOutput[];
+    uint texOutput[];
 };
 
 out vec4 outColour;
 
 
+float readULong(uint i)
+{
+    //64 bit values are stored as two little endian 32 bit halves
+    return float(texOutput[i * 2]) + float(texOutput[i * 2 + 1]) * 4294967296.0f;
+}
+
+vec3 unpackRGB9E5(uint v)
+{
+    //9 bit mantissas for r, g and b above a 5 bit shared exponent, same as in the kernels
+    uvec3 mantissa = uvec3(v >> 23, v >> 14, v >> 5) & ((1u << PACKED_MANTISSA_BITS) - 1u);
+    int exponent = int(v & 31u);
+    return vec3(mantissa) * exp2(float(exponent - PACKED_EXPONENT_BIAS - PACKED_MANTISSA_BITS));
+}
+
+vec3 paletteColour(float t)
+{
+    //linear interpolation between the entry colours in list order
+    if (numEntries < 2u) return entryColours[0];
+
+    float x = clamp(t, 0.0f, 1.0f) * float(numEntries - 1u);
+    uint j = min(uint(x), numEntries - 2u);
+    return mix(entryColours[j], entryColours[j + 1u], x - float(j));
+}
+
+uint histogramIndex(uint x, uint y)
+{
+    //position of pixel (x, y) in the histogram, same as in the kernels
+    if (histogramLayout == LAYOUT_TILED)
+    {
+        uint tilesX = (texWidth + HISTOGRAM_TILE_SIZE - 1u) >> HISTOGRAM_TILE_BITS;
+        uint tile = (y >> HISTOGRAM_TILE_BITS) * tilesX + (x >> HISTOGRAM_TILE_BITS);
+        uint inTile = ((y & (HISTOGRAM_TILE_SIZE - 1u)) << HISTOGRAM_TILE_BITS) | (x & (HISTOGRAM_TILE_SIZE - 1u));
+        return (tile << (2u * HISTOGRAM_TILE_BITS)) | inTile;
+    }
+
+    return y * texWidth + x;
+}
+
+vec4 readAccumulation(uint i)
+{
+    //convert the histogram pixel to float (r, g, b, count) from whichever format it was accumulated in
+    if (accumulationMode == ACCUMULATION_FIXED32)
+    {
+        uvec4 pix = uvec4(texOutput[i * 4], texOutput[i * 4 + 1], texOutput[i * 4 + 2], texOutput[i * 4 + 3]);
+        return vec4(vec3(pix.xyz) / fixedPointScale32, float(pix.w));
+    }
+    else if (accumulationMode == ACCUMULATION_FIXED64)
+    {
+        vec4 pix = vec4(readULong(i * 4), readULong(i * 4 + 1), readULong(i * 4 + 2), readULong(i * 4 + 3));
+        return vec4(pix.xyz / fixedPointScale64, pix.w);
+    }
+    else if (accumulationMode == ACCUMULATION_ENTRY_CHANNELS)
+    {
+        vec4 pix = vec4(0.0f);
+        for (uint j = 0u; j < numEntries; j++)
+        {
+            pix += float(texOutput[i * numEntries + j]) * vec4(entryColours[j], 1.0f);
+        }
+        return pix / ENTRY_CHANNEL_SCALE;
+    }
+    else if (accumulationMode == ACCUMULATION_PACKED_RGB)
+    {
+        return vec4(unpackRGB9E5(texOutput[i * 2]), float(texOutput[i * 2 + 1]));
+    }
+    else if (accumulationMode == ACCUMULATION_PALETTE)
+    {
+        //the first value is the sum of the samples' palette coordinates
+        float count = float(texOutput[i * 2 + 1]);
+        if (count <= 0.0f) return vec4(0.0f);
+        return vec4(paletteColour(float(texOutput[i * 2]) / fixedPointScale32 / count) * count, count);
+    }
+
+    return uintBitsToFloat(uvec4(texOutput[i * 4], texOutput[i * 4 + 1], texOutput[i * 4 + 2], texOutput[i * 4 + 3]));
+}
+
 void main()
 {
     uint x = int(texCoord.x * texWidth);
     uint y = int(texCoord.y * texHeight);
-    uint i = y * texWidth + x;
+    uint i = histogramIndex(x, y);
 
-    vec4 pix = texOutput[i];
+    vec4 pix = readAccumulation(i);
 
     float alphaScale = log2(pix.w) * 0.301 / pix.w;
     pix = brightness * alphaScale * pix;